@@ -2,10 +2,17 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <iterator>
+#include <memory>
 #include <any>
 #include <regex>
 #include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 
 #if !defined(GLOB_USE_GHC_FILESYSTEM) || defined(GHC_DO_NOT_USE_STD_FS)
 #if !__has_include(<filesystem>) || defined(GHC_DO_NOT_USE_STD_FS)
@@ -51,6 +58,145 @@ namespace fs = std::filesystem;
 #endif
 
 
+/// Flags for the free `glob()`, `rglob()` and `filter()` functions.
+enum class match_flags : unsigned {
+	none = 0,
+	case_insensitive = 1,    ///< match path elements regardless of their case (see `options::case_insensitive`)
+	extglob = 2,             ///< recognize the extglob operators `?(..)`, `*(..)`, `+(..)`, `@(..)` and `!(..)` (see `options::extglob`)
+	deduplicate = 4,         ///< the overloads taking several pathnames drop results an earlier pathname already produced (see `dedup_mode::path`)
+	brace_expansion = 8,     ///< expand `{a,b}` brace groups (see `options::brace_expansion`); without it, braces are ordinary characters
+};
+
+/// The order in which `glob()` visits the directories it has queued for scanning (see `options::traversal`).
+enum class traversal_order {
+	breadth_first,           ///< scan directories in the order they were found: level by level, the queue holds every directory found but not yet scanned
+	depth_first,             ///< scan the most recently found directory first: the queue holds the unscanned siblings along the current path only
+	hybrid,                  ///< breadth first while the queue stays within `options::hybrid_queue_limit`, depth first while it exceeds that limit
+};
+
+/// Which results `glob()` considers duplicates of a result reported before, and drops (see `options::deduplicate`).
+enum class dedup_mode {
+	none,                    ///< report every match, e.g. a file matched by two overlapping pathnames is reported twice
+	path,                    ///< the same pathname after `lexically_normal()`, e.g. "src/./a.cpp" and "src/a.cpp"
+	file,                    ///< the same file: device and inode number, which also collapses hardlinks, symlinks and bind mounts (POSIX only, else `path`)
+};
+
+/// The order of the paths produced by `glob()` (see `options::ordering`).
+enum class result_order {
+	unordered,               ///< the order in which they were found: it depends on the file system, the traversal and the thread count
+	bytes,                   ///< sorted by their native pathname, compared code unit by code unit
+	natural,                 ///< sorted by their native pathname, comparing runs of digits by their value: "img9.png" before "img10.png"
+	directory,               ///< a depth first walk of the directories in name order: each directory's matches by name, then those of its subdirectories
+};
+
+constexpr match_flags operator|(match_flags a, match_flags b) noexcept {
+	return match_flags((unsigned)a | (unsigned)b);
+}
+
+constexpr match_flags operator&(match_flags a, match_flags b) noexcept {
+	return match_flags((unsigned)a & (unsigned)b);
+}
+
+/// Compiled shell-style wildcard pattern: `*`, `?`, `[...]` sets (`!` negates, `-` denotes a range) and, when enabled, `{a,b}` brace
+/// alternatives.
+///
+/// This is the default matcher used by `glob()` and `filter()`: matching runs in linear time
+/// (a bit-parallel NFA walk over the name) and does not allocate.
+/// The required literal parts of the pattern (prefix, suffix, the longest literal run in between) and its minimum length are
+/// checked first, so most non-matching names are rejected without running the matcher.
+/// Patterns with more than 63 non-`*` elements walk the NFA over several 64-bit words per step, which is
+/// O(name * pattern / 64); only patterns of more than a thousand elements need a (single) allocation per match.
+///
+/// With `braces` enabled, brace alternatives are expanded when the pattern is compiled and run as a single NFA, e.g. "*.{cpp,h}"
+/// costs one walk over the name; only the literals all alternatives have in common take part in the prefilter. Otherwise `{`, `,`
+/// and `}` match themselves, as they always did.
+///
+/// With `extglob` enabled, patterns using the extglob operators (`?(a|b)`: zero or one, `*(a|b)`: zero or more, `+(a|b)`: one or more,
+/// `@(a|b)`: exactly one of the alternatives, `!(a|b)`: anything except them) are compiled into a DFA instead. `!(..)` is the
+/// complement of its alternatives, so no pattern requires backtracking: matching is a single table-driven walk over the name.
+///
+/// Case-insensitive matchers fold the case of the pattern up front: ASCII names then cost the same as with a
+/// case-sensitive matcher. Names which contain UTF-8 sequences are case folded (simple case folding for the
+/// Latin, Greek, Cyrillic and Armenian scripts and fullwidth forms) before matching.
+class wildcard_matcher {
+public:
+	using match_function = bool (*)(std::string_view name) noexcept;
+
+	wildcard_matcher() = default;
+	explicit wildcard_matcher(std::string_view pattern, bool case_insensitive = false, bool extglob = false, bool braces = false);
+
+	/// Wraps a matcher which has been specialized for `pattern` beforehand, e.g. `glob::static_pattern<"*.json">::match`:
+	/// no runtime compilation takes place and `match()` forwards to `specialized`.
+	wildcard_matcher(std::string_view pattern, match_function specialized);
+
+	/// \return true when `name` matches the pattern in its entirety.
+	bool match(std::string_view name) const noexcept;
+
+	const std::string &pattern() const noexcept {
+		return source;
+	}
+
+	bool case_insensitive() const noexcept {
+		return fold_case;
+	}
+
+	bool extglob() const noexcept {
+		return extended;
+	}
+
+	bool braces() const noexcept {
+		return expand_braces;
+	}
+
+private:
+	struct automaton;
+
+	struct atom {
+		std::array<uint64_t, 4> set;  // 256-bit set of the accepted byte values
+		bool star_before;             // a '*' precedes this atom
+	};
+
+	// a brace alternative: `program[begin, end)`.
+	struct alternative {
+		std::size_t begin;
+		std::size_t end;
+		bool trailing_star;
+	};
+
+	void compile_alternative(std::string_view pattern);
+	void extract_literals();
+	bool match_folded(std::string_view name) const noexcept;
+	bool match_wide(std::string_view name) const noexcept;
+
+	std::string source;
+	match_function specialized = nullptr;
+	bool fold_case = false;             // the pattern and the literals below have been case folded
+	bool extended = false;              // extglob operators are recognized
+	bool expand_braces = false;         // `{a,b}` groups are alternatives
+	std::shared_ptr<const automaton> dfa;    // the compiled pattern when it uses extglob operators
+	std::vector<atom> program;
+	bool trailing_star = false;
+	std::vector<alternative> alternatives;   // empty unless the pattern has brace alternatives
+
+	// prefilter: the literal parts every match must have, e.g. the ".pdf" suffix of "*.pdf", checked before running the matcher proper.
+	std::string literal_prefix;
+	std::string literal_suffix;
+	std::string literal_infix;          // the longest literal run in between, which must occur between prefix and suffix
+	std::size_t min_length = 0;
+	bool exact_length = false;          // no '*' at all: names must be exactly `min_length` long
+	bool literals_decide = false;       // the pattern is fully described by the literals, e.g. "lib*.so": passing the prefilter is a match
+
+	// bit-parallel form of `program`: state bit K is set when the first K atoms have been matched. Every brace alternative
+	// gets a start state of its own, followed by the states of its atoms.
+	static constexpr std::size_t wide_words_inline = 16;
+	std::size_t state_words = 1;
+	uint64_t start_states = 1;
+	uint64_t star_states = 0;
+	uint64_t accept_states = 1;
+	std::array<uint64_t, 256> transitions{};
+	std::vector<uint64_t> wide_masks;   // more than 64 states: the start, star and accept sets, then 256 transition sets, `state_words` each
+};
+
 /// Helper struct for extended options
 struct options {
 	fs::path basepath;
@@ -61,6 +207,84 @@ struct options {
 	bool include_matching_directories = false;   // include directories which match the last wildcard, e.g. when searching for "*.pdf" match a directory named "collection.pdf/"
 	bool include_matching_files = true;          // include files which match the last wildcard, e.g. when searching for "*.pdf" match a file named "article.pdf"
 
+	// scan the directory tree only once for all `pathnames`: every directory visited by multiple pathnames is listed only once and its entries
+	// are matched against all those pathnames together, e.g. "src/**/*.cpp" + "src/**/*.h" walk the "src/" tree once.
+	// `filter()` is still invoked per pathname (see `filter_info_t::original_search_spec_index`), but results are now reported in tree walk order.
+	bool merge_overlapping_specs = false;
+
+	// the order in which directories are scanned. `breadth_first` keeps every directory which has been found, but not yet scanned, in
+	// the queue: for very large trees `depth_first` (memory proportional to the depth times the fan-out of the tree) or `hybrid` are
+	// cheaper. Multi-threaded runs (see `thread_count`) always scan depth first per worker thread.
+	traversal_order traversal = traversal_order::breadth_first;
+
+	// `traversal_order::hybrid`: the number of queued directories beyond which the scan continues depth first.
+	int hybrid_queue_limit = 65536;
+
+	// produce the results in a stable order, independent of the file system and of `thread_count`. `bytes` and `natural` sort the native
+	// pathnames once the scan has completed (multi-threaded runs sort per worker thread and merge those on all threads), while `directory`
+	// sorts every directory listing by name and scans depth first: it always runs on the calling thread, regardless of `thread_count`.
+	// `glob_range` only honours `directory`.
+	result_order ordering = result_order::unordered;
+
+	// drop results which duplicate one reported before, e.g. when the pathnames "**/*.cpp" and "src/*.cpp" overlap. Duplicates are dropped
+	// while scanning, so the first path found for a file is the one reported (see `dedup_mode`). `dedup_mode::file` takes the inode numbers
+	// from the listings of `use_native_directory_reader`; other results, directories among them, cost a stat() each.
+	dedup_mode deduplicate = dedup_mode::none;
+
+	// expand `{a,b}` brace groups, as in the shell: "src/{core,net}/*.{cpp,h}". Groups in directory elements are looked up (or walked)
+	// once for their shared prefix, groups within a wildcarded element become alternatives of a single matcher. When disabled, braces
+	// are ordinary characters of file names.
+	bool brace_expansion = false;
+
+	// recognize the extglob operators in wildcards, e.g. "!(*.o|*.a)" or "lib+([0-9]).so" (see `wildcard_matcher`).
+	bool extglob = false;
+
+	// match regardless of case, e.g. "*.pdf" matches "REPORT.PDF". This applies to literal path elements as well ("Src/*.cpp" finds
+	// "src/a.cpp" on a case-sensitive file system), so those are matched against a listing of their parent directory instead of being
+	// looked up directly.
+	bool case_insensitive = false;
+
+	// list directories with the OS-native API instead of `fs::directory_iterator`, where available (Linux: `getdents64()`, which reports the
+	// entry type along with the name, so there's no stat per entry). Ignored on other platforms.
+	// The native reader does not produce `fs::directory_entry` objects, hence `filter_info_t::entry` is left empty: use `is_directory` and
+	// `basepath / item_relpath` instead.
+	// The default is set at build time: define GLOB_USE_NATIVE_DIRECTORY_READER (CMake option of the same name) to enable it.
+#if defined(GLOB_USE_NATIVE_DIRECTORY_READER)
+	bool use_native_directory_reader = true;
+#else
+	bool use_native_directory_reader = false;
+#endif
+
+	// the number of threads scanning the directory tree: 1 (default) scans on the calling thread, 0 uses one thread per hardware thread.
+	// Each thread works off its own queue of directories and steals from the others when it runs out of work.
+	// Ignored with `ordering` set to `result_order::directory`, which scans on the calling thread.
+	// When running multi-threaded:
+	// - `filter()` and `progress_reporting()` are invoked concurrently from the worker threads, hence userland overrides must be thread-safe.
+	//   The `filter_info_t` passed to them is private to the call. The final (100% done) progress report is made on the calling thread.
+	// - returning `false` from `progress_reporting()` stops all threads.
+	// - the order of the results is unspecified, and `filter_info_t::item_count_scanned`, `dir_count_scanned` and `actual_search_spec_index`
+	//   are estimates until the final progress report.
+	int thread_count = 1;
+
+	// wildcards which have been compiled beforehand, e.g. `glob::static_pattern<"*.proto">::matcher()`: wildcarded elements of `pathnames`
+	// with the same text use these instead of being compiled at the start of every glob() run.
+	std::vector<wildcard_matcher> precompiled_matchers;
+
+	// with the native directory reader on Linux: resolve the type of symlinks and of entries the file system doesn't report a type for
+	// (`DT_UNKNOWN`) with batched `statx()` requests through io_uring, one batch per directory read, instead of a `fstatat()` call per entry.
+	// Single-threaded runs also submit `openat()` requests for the next few queued directories, so they are opened while the current one
+	// is being matched. Falls back to `fstatat()` and `openat()` calls when io_uring is unavailable or blocked.
+	bool use_io_uring = false;
+
+	// hand the entries of every directory listing to `filter_batch()` at once, instead of passing them to `filter()` one by one: this
+	// lets filters amortize per-directory work, such as a database lookup. The results of a directory are then only produced once its
+	// listing is complete.
+	bool use_batch_filter = false;
+
+	// also fill the path fields of the `filter_info_t` passed to the callbacks, e.g. for callbacks written against older releases.
+	// By default only its view of the scan state is set, which the `get_...()` accessors read without copying any path.
+	bool copy_filter_info_paths = false;
+
 	//bool follow_symlinks = true;    <-- userland code can call fs::weak_canonical(path) on all entries instead.
 
 	// --------------------------------------------------------------------------------------
@@ -84,6 +308,7 @@ struct options {
 	typedef struct filter_state_t filter_state_t;
 
 	struct filter_info_t {
+		// copies of the scan state: left empty unless `options::copy_filter_info_paths` is set, use the `get_...()` accessors below instead.
 		fs::path basepath;
 		fs::path item_relpath;
 		fs::directory_entry entry;
@@ -109,12 +334,81 @@ struct options {
 		int original_search_spec_index;
 		int actual_search_spec_index;
 		int search_spec_count;
+
+		// the order in which the directory being scanned was taken from the queue: with `traversal_order::hybrid` this is `depth_first`
+		// while the queue exceeds `options::hybrid_queue_limit` and `breadth_first` otherwise.
+		traversal_order traversal;
+
+		// a view of the scan state, which is only valid during the callback: the accessors only construct their path when called.
+		const fs::path *basepath_ref = nullptr;
+		const fs::path *item_relpath_ref = nullptr;          // NULL: `item_name` is the relative path
+		std::string_view item_name;
+		const fs::directory_entry *entry_ref = nullptr;      // NULL when there's none, e.g. with `use_native_directory_reader`
+
+		const fs::path *matching_wildcarded_fragment_ref = nullptr;
+		const fs::path *subsearch_spec_ref = nullptr;
+
+		const fs::path &get_basepath() const {
+			return basepath_ref ? *basepath_ref : basepath;
+		}
+		fs::path get_item_relpath() const {
+			if (item_relpath_ref)
+				return *item_relpath_ref;
+			return item_name.empty() ? item_relpath : fs::path(item_name);
+		}
+		const fs::directory_entry &get_entry() const {
+			return entry_ref ? *entry_ref : entry;
+		}
+		const fs::path &get_matching_wildcarded_fragment() const {
+			return matching_wildcarded_fragment_ref ? *matching_wildcarded_fragment_ref : matching_wildcarded_fragment;
+		}
+		const fs::path &get_subsearch_spec() const {
+			return subsearch_spec_ref ? *subsearch_spec_ref : subsearch_spec;
+		}
 	};
 
 	// filter callback: returns pass/reject for given path; this can override the default glob reject/accept logic in either direction
 	// as both rejected and accepted entries are fed to this callback method.
+	// A plain `glob::options` instance doesn't call it at all: neither are its `filter_info_t` and the full path of non-matching entries built.
 	virtual filter_state_t filter(fs::path path, filter_state_t glob_says_pass, const filter_info_t &info);
 
+	// one entry of a directory listing, as passed to `filter_batch()`.
+	struct batch_entry_t {
+		std::string_view name;
+		bool is_directory;
+		bool is_hidden;
+		filter_state_t verdict;			// glob's own verdict, which `filter_batch()` may override in either direction, just like `filter()` does
+	};
+
+	// the entries passed to `filter_batch()`: a mutable view, usable in range-for loops.
+	struct batch_entries_t {
+		batch_entry_t *entries = nullptr;
+		std::size_t count = 0;
+
+		batch_entry_t *begin() const noexcept {
+			return entries;
+		}
+		batch_entry_t *end() const noexcept {
+			return entries + count;
+		}
+		std::size_t size() const noexcept {
+			return count;
+		}
+		bool empty() const noexcept {
+			return count == 0;
+		}
+		batch_entry_t &operator[](std::size_t index) const noexcept {
+			return entries[index];
+		}
+	};
+
+	// batch filter callback, used instead of `filter()` for the entries of directory listings when `use_batch_filter` is set:
+	// it receives all entries of `basepath` which were matched against a wildcard or '**' element at once, and updates their verdicts in place.
+	// `info` describes the directory and the spec element. Entries are acted upon in listing order once the callback returns;
+	// `stop_scan_for_this_spec` drops the entries following it.
+	// Literal path elements and the '**' matching the directory itself are still passed to `filter()`.
+	virtual void filter_batch(const fs::path &basepath, batch_entries_t entries, const filter_info_t &info);
+
 	using progress_info_t = filter_info_t;
 
 	// progress callback: shows currently processed path, pass/reject status and progress/scan completion estimate.
@@ -156,7 +450,7 @@ struct options {
 /// Pathnames can be absolute (/usr/src/Foo/Makefile) or relative (../../Tools/*/*.gif)
 /// Pathnames can contain shell-style wildcards
 /// Broken symlinks are included in the results (as in the shell)
-std::vector<fs::path> glob(const std::string &pathname);
+std::vector<fs::path> glob(const std::string &pathname, match_flags flags = match_flags::none);
 
 /// \param basepath the root directory to run in
 /// \param pathname string containing a path specification
@@ -165,7 +459,7 @@ std::vector<fs::path> glob(const std::string &pathname);
 /// Pathnames can be absolute (/usr/src/Foo/Makefile) or relative (../../Tools/*/*.gif)
 /// Pathnames can contain shell-style wildcards
 /// Broken symlinks are included in the results (as in the shell)
-std::vector<fs::path> glob_path(const std::string& basepath, const std::string& pathname);
+std::vector<fs::path> glob_path(const std::string& basepath, const std::string& pathname, match_flags flags = match_flags::none);
 
 /// \param pathnames string containing a path specification
 /// \return vector of paths that match the pathname
@@ -173,7 +467,7 @@ std::vector<fs::path> glob_path(const std::string& basepath, const std::string&
 /// Globs recursively.
 /// The pattern “**” will match any files and zero or more directories, subdirectories and
 /// symbolic links to directories.
-std::vector<fs::path> rglob(const std::string &pathname);
+std::vector<fs::path> rglob(const std::string &pathname, match_flags flags = match_flags::none);
 
 /// \param basepath the root directory to run in
 /// \param pathnames string containing a path specification
@@ -182,44 +476,818 @@ std::vector<fs::path> rglob(const std::string &pathname);
 /// Globs recursively.
 /// The pattern “**” will match any files and zero or more directories, subdirectories and
 /// symbolic links to directories.
-std::vector<fs::path> rglob_path(const std::string& basepath, const std::string& pathname);
+std::vector<fs::path> rglob_path(const std::string& basepath, const std::string& pathname, match_flags flags = match_flags::none);
 
 /// Runs `glob` against each pathname in `pathnames` and accumulates the results
-std::vector<fs::path> glob(const std::vector<std::string> &pathnames);
+std::vector<fs::path> glob(const std::vector<std::string> &pathnames, match_flags flags = match_flags::none);
 
 /// Runs `glob` against each pathname in `pathnames` and accumulates the results
-std::vector<fs::path> glob_path(const std::string& basepath, const std::vector<std::string> &pathnames);
+std::vector<fs::path> glob_path(const std::string& basepath, const std::vector<std::string> &pathnames, match_flags flags = match_flags::none);
 
 /// Runs `rglob` against each pathname in `pathnames` and accumulates the results
-std::vector<fs::path> rglob(const std::vector<std::string> &pathnames);
+std::vector<fs::path> rglob(const std::vector<std::string> &pathnames, match_flags flags = match_flags::none);
 
 /// Runs `rglob` against each pathname in `pathnames` and accumulates the results
-std::vector<fs::path> rglob_path(const std::string& basepath, const std::vector<std::string>& pathnames);
+std::vector<fs::path> rglob_path(const std::string& basepath, const std::vector<std::string>& pathnames, match_flags flags = match_flags::none);
 
 /// Initializer list overload for convenience
-std::vector<fs::path> glob(const std::initializer_list<std::string> &pathnames);
+std::vector<fs::path> glob(const std::initializer_list<std::string> &pathnames, match_flags flags = match_flags::none);
 
 /// Initializer list overload for convenience
-std::vector<fs::path> glob_path(const std::string& basepath, const std::initializer_list<std::string>& pathnames);
+std::vector<fs::path> glob_path(const std::string& basepath, const std::initializer_list<std::string>& pathnames, match_flags flags = match_flags::none);
 
 /// Initializer list overload for convenience
-std::vector<fs::path> rglob(const std::initializer_list<std::string> &pathnames);
+std::vector<fs::path> rglob(const std::initializer_list<std::string> &pathnames, match_flags flags = match_flags::none);
 
 /// Initializer list overload for convenience
-std::vector<fs::path> rglob_path(const std::string& basepath, const std::initializer_list<std::string>& pathnames);
+std::vector<fs::path> rglob_path(const std::string& basepath, const std::initializer_list<std::string>& pathnames, match_flags flags = match_flags::none);
 
 std::vector<fs::path> glob(const options &search_specification);
 std::vector<fs::path> glob(options &search_specification);
 
+/// Compact container of paths: the paths are stored back to back in a single character arena, along with a table of
+/// their end offsets, so a million paths cost two allocations (plus regrowth) rather than a million.
+///
+/// The paths are accessed as views of their native text, e.g.
+///
+///     glob::path_arena results;
+///     glob::glob(spec, results);
+///     for (auto path : results) { ... }    // path: std::basic_string_view<fs::path::value_type>
+///
+/// Views remain valid until the next `push_back()`, `clear()` or `reserve()`. `path()` and `to_paths()` convert to
+/// `fs::path` when needed.
+class path_arena {
+public:
+	using string_type = fs::path::string_type;
+	using string_view_type = std::basic_string_view<fs::path::value_type>;
+
+	class iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using iterator_concept = std::forward_iterator_tag;
+		using value_type = string_view_type;
+		using difference_type = std::ptrdiff_t;
+		using reference = string_view_type;
+
+		iterator() = default;
+
+		reference operator*() const {
+			return (*arena)[index];
+		}
+
+		iterator &operator++() {
+			index++;
+			return *this;
+		}
+		iterator operator++(int) {
+			iterator before = *this;
+			index++;
+			return before;
+		}
+
+		friend bool operator==(const iterator &a, const iterator &b) {
+			return a.index == b.index;
+		}
+		friend bool operator!=(const iterator &a, const iterator &b) {
+			return a.index != b.index;
+		}
+
+	private:
+		friend class path_arena;
+		iterator(const path_arena *arena, std::size_t index) : arena(arena), index(index) {}
+
+		const path_arena *arena = nullptr;
+		std::size_t index = 0;
+	};
+
+	void push_back(string_view_type path) {
+		text.append(path);
+		ends.push_back(text.size());
+	}
+
+	/// Reserves room for `count` paths of `characters` characters in total.
+	void reserve(std::size_t count, std::size_t characters) {
+		ends.reserve(count);
+		text.reserve(characters);
+	}
+
+	void clear() noexcept {
+		text.clear();
+		ends.clear();
+	}
+
+	std::size_t size() const noexcept {
+		return ends.size();
+	}
+	bool empty() const noexcept {
+		return ends.empty();
+	}
+
+	/// \return the number of characters stored for all paths together.
+	std::size_t characters() const noexcept {
+		return text.size();
+	}
+
+	string_view_type operator[](std::size_t index) const noexcept {
+		const std::size_t begin = (index ? ends[index - 1] : 0);
+		return string_view_type(text).substr(begin, ends[index] - begin);
+	}
+
+	fs::path path(std::size_t index) const {
+		return fs::path(string_type((*this)[index]));
+	}
+
+	std::vector<fs::path> to_paths() const {
+		std::vector<fs::path> paths;
+		paths.reserve(size());
+		for (std::size_t index = 0; index < size(); index++) {
+			paths.push_back(path(index));
+		}
+		return paths;
+	}
+
+	iterator begin() const {
+		return iterator(this, 0);
+	}
+	iterator end() const {
+		return iterator(this, size());
+	}
+
+private:
+	string_type text;
+	std::vector<std::size_t> ends;     // the end offset of every path in `text`
+};
+
+/// `glob(options&)`, appending the accepted paths to `results`: no `fs::path` is kept per result.
+void glob(options &search_specification, path_arena &results);
+
+/// Paths stored as a tree: every directory is a node pointing at its parent, and every path is a leaf name in one of those
+/// directories. Paths which share their directories only store those once, e.g. "/srv/data/2026/10/a.log" and
+/// "/srv/data/2026/10/b.log" add "b.log" to the node of "/srv/data/2026/10/", which in turn only stores "10/".
+///
+/// Paths are rebuilt on demand by `path()`, and `entries()` lists the paths in a directory without any string handling:
+///
+///     glob::path_tree results;
+///     glob::glob(spec, results);
+///     for (std::size_t dir = 0; dir < results.directory_count(); dir++) {
+///         std::cout << results.directory_path(dir) << ": " << results.entries(dir).size() << " matches\n";
+///     }
+///
+/// Paths are split at their separators as they are: reconstructed paths are identical to the ones added.
+class path_tree {
+public:
+	using string_type = fs::path::string_type;
+	using string_view_type = std::basic_string_view<fs::path::value_type>;
+
+	/// The directory of paths without any separator, e.g. "a.txt", and the parent of top-level directories.
+	static constexpr std::size_t no_directory = std::size_t(-1);
+
+	void push_back(const fs::path &path);
+	void clear();
+
+	/// \return the number of paths.
+	std::size_t size() const noexcept {
+		return leaves.size();
+	}
+	bool empty() const noexcept {
+		return leaves.empty();
+	}
+
+	fs::path path(std::size_t index) const;
+	std::vector<fs::path> to_paths() const;
+
+	/// \return the name of path `index` within its directory.
+	string_view_type name(std::size_t index) const noexcept {
+		return string_view_type(text).substr(leaves[index].begin, leaves[index].length);
+	}
+
+	/// \return the directory of path `index`, or `no_directory`.
+	std::size_t directory(std::size_t index) const noexcept {
+		return leaves[index].directory;
+	}
+
+	std::size_t directory_count() const noexcept {
+		return directories.size();
+	}
+
+	/// \return the parent of `directory`, or `no_directory`.
+	std::size_t parent(std::size_t directory) const noexcept {
+		return directories[directory].parent;
+	}
+
+	fs::path directory_path(std::size_t directory) const;
+
+	/// \return the indices of the paths in `directory`, in the order they were added; paths in its subdirectories are not included.
+	const std::vector<std::size_t> &entries(std::size_t directory) const noexcept {
+		return directories[directory].entries;
+	}
+
+private:
+	struct directory_node {
+		std::size_t parent;
+		std::size_t begin;          // the text this directory appends to its parent, including the separator which ends it, e.g. "10/"
+		std::size_t length;
+		std::vector<std::size_t> entries;
+	};
+
+	struct leaf {
+		std::size_t directory;
+		std::size_t begin;
+		std::size_t length;
+	};
+
+	struct node_key {
+		std::size_t parent;
+		string_type name;
+
+		bool operator==(const node_key &other) const noexcept {
+			return parent == other.parent && name == other.name;
+		}
+	};
+
+	struct node_key_hash {
+		std::size_t operator()(const node_key &key) const noexcept {
+			return std::hash<string_type>()(key.name) ^ (key.parent * 0x9E3779B97F4A7C15ull);
+		}
+	};
+
+	std::size_t intern_directory(string_view_type path);
+	void append_directory(string_type &out, std::size_t directory) const;
+
+	string_type text;                   // the names of all directories and paths, back to back
+	std::vector<directory_node> directories;
+	std::vector<leaf> leaves;
+	std::unordered_map<node_key, std::size_t, node_key_hash> lookup;
+
+	// the directory of the previously added path: consecutive results usually share their directory.
+	string_type last_directory_text;
+	std::size_t last_directory = no_directory;
+};
+
+/// `glob(options&)`, adding the accepted paths to `results`.
+void glob(options &search_specification, path_tree &results);
+
+namespace detail {
+
+	template <typename Policy, typename = void>
+	struct has_filter : std::false_type {};
+	template <typename Policy>
+	struct has_filter<Policy, std::void_t<decltype(options::filter_state_t(std::declval<Policy &>().filter(
+		std::declval<options::filter_state_t>(), std::declval<const options::filter_info_t &>())))>> : std::true_type {};
+
+	template <typename Policy, typename = void>
+	struct has_progress_reporting : std::false_type {};
+	template <typename Policy>
+	struct has_progress_reporting<Policy, std::void_t<decltype(bool(std::declval<Policy &>().progress_reporting(
+		std::declval<const options::progress_info_t &>(), std::declval<options::filter_state_t>())))>> : std::true_type {};
+
+	template <typename Policy, typename = void>
+	struct has_include_hidden_entries : std::false_type {};
+	template <typename Policy>
+	struct has_include_hidden_entries<Policy, std::void_t<decltype(bool(Policy::include_hidden_entries))>> : std::true_type {};
+
+	template <typename Policy, typename = void>
+	struct has_include_matching_directories : std::false_type {};
+	template <typename Policy>
+	struct has_include_matching_directories<Policy, std::void_t<decltype(bool(Policy::include_matching_directories))>> : std::true_type {};
+
+	template <typename Policy, typename = void>
+	struct has_include_matching_files : std::false_type {};
+	template <typename Policy>
+	struct has_include_matching_files<Policy, std::void_t<decltype(bool(Policy::include_matching_files))>> : std::true_type {};
+
+	// the options `basic_glob<Policy>` runs with: a `final` class, so that its callbacks call the policy directly. The entries of
+	// a directory listing are filtered in one `filter_batch()` call, which loops over them in this header, instantiated for `Policy`.
+	template <typename Policy>
+	class policy_options final : public options {
+	public:
+		policy_options(options &&search_spec, Policy &&policy)
+			: options(std::move(search_spec)),
+			policy(std::move(policy))
+		{}
+
+		filter_state_t filter(fs::path /*path*/, filter_state_t glob_says_pass, const filter_info_t &info) override {
+			if constexpr (has_filter<Policy>::value)
+				return policy.filter(glob_says_pass, info);
+			else
+				return glob_says_pass;
+		}
+
+		void filter_batch(const fs::path & /*basepath*/, batch_entries_t entries, const filter_info_t &directory_info) override {
+			if constexpr (has_filter<Policy>::value) {
+				filter_info_t info = directory_info;
+				for (auto &entry : entries) {
+					info.item_name = entry.name;
+					info.is_directory = entry.is_directory;
+					info.is_hidden = entry.is_hidden;
+					if (copy_filter_info_paths)
+						info.item_relpath = fs::path(entry.name);
+					entry.verdict = policy.filter(entry.verdict, info);
+					if (entry.verdict.stop_scan_for_this_spec)
+						break;
+				}
+			}
+		}
+
+		bool progress_reporting(const progress_info_t &info, const filter_state_t state) override {
+			if constexpr (has_progress_reporting<Policy>::value)
+				return policy.progress_reporting(info, state);
+			else
+				return true;
+		}
+
+		Policy policy;
+	};
+
+} // namespace detail
+
+/// Policy-based front end to `glob(options&)`: the callbacks and the `include_*` flags are members of `Policy`, which are
+/// resolved at compile time instead of through the virtual members of `options`, e.g.
+///
+///     struct sources_only {
+///         static constexpr bool include_hidden_entries = false;
+///
+///         glob::options::filter_state_t filter(glob::options::filter_state_t state, const glob::options::filter_info_t &info) {
+///             state.accept &= info.is_directory || info.item_name.ends_with(".cpp");
+///             return state;
+///         }
+///     };
+///
+///     glob::basic_glob<sources_only> query(glob::options(root, "src/**"));
+///     auto results = query.run();
+///
+/// All `Policy` members are optional:
+/// - `include_hidden_entries`, `include_matching_directories` and `include_matching_files`: `static constexpr bool` values which
+///   override those of `specification()`.
+/// - `filter(filter_state_t glob_says_pass, const filter_info_t &info)`: the equivalent of `options::filter()`. The entry is
+///   described by `info` alone: its path is `info.get_basepath() / info.get_item_relpath()`, its name `info.item_name` when
+///   it comes from a directory listing, and no `fs::path` is constructed for it before the call. The entries of each directory
+///   listing are passed through `filter()` in a single loop instantiated for `Policy` (see `options::use_batch_filter`), so the
+///   calls are direct and can be inlined: only one virtual call per directory remains.
+/// - `progress_reporting()`, with the signature of `options::progress_reporting()`.
+///
+/// Without `filter()` and `progress_reporting()`, `run()` scans with a plain `glob::options`, which doesn't invoke any
+/// callbacks at all.
+template <typename Policy>
+class basic_glob {
+	static constexpr bool has_callbacks = detail::has_filter<Policy>::value || detail::has_progress_reporting<Policy>::value;
+
+	using options_type = std::conditional_t<has_callbacks, detail::policy_options<Policy>, options>;
+
+public:
+	explicit basic_glob(options search_specification, Policy policy = Policy())
+		: spec(make_options(std::move(search_specification), std::move(policy)))
+	{}
+
+	/// The rest of the search specification, e.g. `basepath`, `pathnames` and `thread_count`.
+	options &specification() noexcept {
+		return spec;
+	}
+
+	/// The policy instance the callbacks are invoked on, e.g. to read the state it collected. Only available when `Policy`
+	/// has callbacks: a policy without them is not kept.
+	Policy &callbacks() noexcept {
+		return spec.policy;
+	}
+
+	std::vector<fs::path> run() {
+		apply_policy_flags();
+		return glob(spec);
+	}
+
+	void run(path_arena &results) {
+		apply_policy_flags();
+		glob(spec, results);
+	}
+
+	void run(path_tree &results) {
+		apply_policy_flags();
+		glob(spec, results);
+	}
+
+private:
+	static options_type make_options(options &&search_spec, Policy &&policy) {
+		if constexpr (has_callbacks) {
+			return options_type(std::move(search_spec), std::move(policy));
+		}
+		else {
+			return std::move(search_spec);
+		}
+	}
+
+	void apply_policy_flags() noexcept {
+		if constexpr (detail::has_include_hidden_entries<Policy>::value)
+			spec.include_hidden_entries = Policy::include_hidden_entries;
+		if constexpr (detail::has_include_matching_directories<Policy>::value)
+			spec.include_matching_directories = Policy::include_matching_directories;
+		if constexpr (detail::has_include_matching_files<Policy>::value)
+			spec.include_matching_files = Policy::include_matching_files;
+		if constexpr (detail::has_filter<Policy>::value)
+			spec.use_batch_filter = true;
+	}
+
+	options_type spec;
+};
+
+/// `glob(options&)` with all the up-front work done once: `~` expansion, parsing of the pathnames and compilation of
+/// their wildcards, so that each `run()` only pays for the scan itself.
+///
+/// Everything which shapes the search is taken from the options at preparation: `basepath`, `pathnames`,
+/// `max_recursion_depth`, `merge_overlapping_specs`, `use_native_directory_reader`, `use_io_uring` and
+/// `precompiled_matchers`. `run(options&)` takes the callbacks, the `include_*` flags and `thread_count` from
+/// the options passed to it instead; `run()` uses those of the preparation.
+///
+/// As with `glob()`, a query prepared from a non-const `options` keeps a reference to it, so `run()` invokes the
+/// `filter()` and `progress_reporting()` overrides of that object, which must outlive the query. A query prepared
+/// from a const `options` keeps a copy of the `options` base only, so `run()` uses the default callbacks.
+/// A prepared query is immutable: it can be run any number of times, also concurrently from multiple threads
+/// (running concurrently through `run()` then calls the callbacks of the one referenced `options` concurrently).
+class prepared_query {
+public:
+	explicit prepared_query(const options &search_specification);
+	explicit prepared_query(options &search_specification);
+	~prepared_query();
+
+	prepared_query(prepared_query &&) noexcept;
+	prepared_query &operator=(prepared_query &&) noexcept;
+
+	std::vector<fs::path> run() const;
+	std::vector<fs::path> run(options &search_specification) const;
+
+private:
+	struct state;
+	std::unique_ptr<state> impl;
+};
+
+/// Lazily evaluated `glob(options&)`: iterating the range yields each accepted path as soon as the scan finds it, e.g.
+///
+///     for (const auto &path : glob::glob_range(spec)) { ... }
+///
+/// The scan only progresses while the range is being iterated, so memory use is bounded by the queue of directories
+/// still to visit rather than by the number of results. Destroying the range early stops the scan.
+/// The range always scans on the calling thread (`options::thread_count` is ignored) and `search_specification`
+/// must outlive it.
+class glob_range {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = fs::path;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const fs::path *;
+		using reference = const fs::path &;
+
+		iterator() = default;
+
+		reference operator*() const {
+			return range->current;
+		}
+		pointer operator->() const {
+			return &range->current;
+		}
+
+		iterator &operator++() {
+			if (!range->advance())
+				range = nullptr;
+			return *this;
+		}
+		void operator++(int) {
+			++*this;
+		}
+
+		friend bool operator==(const iterator &a, const iterator &b) {
+			return a.range == b.range;
+		}
+		friend bool operator!=(const iterator &a, const iterator &b) {
+			return a.range != b.range;
+		}
+
+	private:
+		friend class glob_range;
+		explicit iterator(glob_range *range) : range(range) {}
+
+		glob_range *range = nullptr;
+	};
+
+	explicit glob_range(options &search_specification);
+	~glob_range();
+
+	glob_range(glob_range &&) noexcept;
+	glob_range &operator=(glob_range &&) noexcept;
+
+	/// Starts the scan on first use; as with any input range, the range can only be iterated once.
+	iterator begin();
+	iterator end() {
+		return iterator();
+	}
+
+private:
+	struct state;
+
+	/// Scan until the next accepted path is available in `current`; returns false once the scan is done.
+	bool advance();
+
+	std::unique_ptr<state> impl;
+	fs::path current;
+	bool started = false;
+	bool done = false;
+};
+
 /// Helper function: expand '~' HOME part (when used in the path) and normalize the given path.
 fs::path expand_and_normalize_tilde(fs::path path);
 
 bool follow_symlink(fs::directory_entry &entry);
 
+/// \return the regex equivalent of the given wildcard pattern, for callers which want to feed it to std::regex.
 std::string translate_pattern(std::string_view pattern);
 std::regex compile_pattern(std::string_view pattern);
 bool fnmatch(std::string&& name,const std::regex& pattern);
-std::vector<fs::path> filter(const std::vector<fs::path> &names,std::string_view pattern);
+
+wildcard_matcher compile_wildcard(std::string_view pattern, bool case_insensitive = false, bool extglob = false, bool braces = false);
+bool fnmatch(std::string_view name, const wildcard_matcher& pattern) noexcept;
+
+std::vector<fs::path> filter(const std::vector<fs::path> &names,std::string_view pattern, match_flags flags = match_flags::none);
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+
+/// A string literal as a template argument, e.g. `glob::static_pattern<"*.json">`.
+template <std::size_t N>
+struct fixed_string {
+	char chars[N]{};
+
+	constexpr fixed_string(const char (&str)[N]) {
+		for (std::size_t i = 0; i < N; i++) {
+			chars[i] = str[i];
+		}
+	}
+
+	constexpr std::string_view view() const {
+		return std::string_view{chars, N - 1};
+	}
+};
+
+namespace detail {
+
+	/// \return the index just past the `[...]` set starting at `pattern[i]`, or 0 when it is not terminated (same rules as `wildcard_matcher`).
+	constexpr std::size_t set_end(std::string_view pattern, std::size_t i) {
+		std::size_t j = i + 1;
+		if (j < pattern.size() && pattern[j] == '!')
+			j++;
+		if (j < pattern.size() && pattern[j] == ']')
+			j++;
+		while (j < pattern.size() && pattern[j] != ']')
+			j++;
+		return j < pattern.size() ? j + 1 : 0;
+	}
+
+	/// `set_check(...) < 0`: the set contains a reversed range; otherwise the set does (1) or does not (0) match `c`.
+	constexpr int set_check(std::string_view pattern, std::size_t i, std::size_t end, unsigned char c) {
+		std::size_t j = i + 1;
+		bool negate = false;
+		if (pattern[j] == '!') {
+			negate = true;
+			j++;
+		}
+		bool found = false;
+		for (std::size_t k = j; k < end - 1; ) {
+			unsigned char lo = pattern[k];
+			if (k + 2 < end - 1 && pattern[k + 1] == '-') {
+				unsigned char hi = pattern[k + 2];
+				if (lo > hi)
+					return -1;
+				found |= (lo <= c && c <= hi);
+				k += 3;
+			}
+			else {
+				found |= (lo == c);
+				k += 1;
+			}
+		}
+		return found != negate;
+	}
+
+	/// Every `[...]` set is terminated and has no reversed (empty) ranges: at runtime those are accepted, but in a
+	/// pattern written in the source code they're almost certainly a mistake.
+	constexpr bool is_valid_wildcard(std::string_view pattern) {
+		for (std::size_t i = 0; i < pattern.size(); i++) {
+			if (pattern[i] == '[') {
+				std::size_t end = set_end(pattern, i);
+				if (end == 0 || set_check(pattern, i, end, 0) < 0)
+					return false;
+				i = end - 1;
+			}
+		}
+		return true;
+	}
+
+	/// Whether `pattern` contains a `{a,b}` brace group, which `wildcard_matcher` expands into alternatives.
+	constexpr bool has_brace_alternatives(std::string_view pattern) {
+		for (std::size_t i = 0; i < pattern.size(); i++) {
+			if (pattern[i] == '[' && set_end(pattern, i) != 0) {
+				i = set_end(pattern, i) - 1;
+			}
+			else if (pattern[i] == '{') {
+				int depth = 0;
+				for (std::size_t j = i + 1; j < pattern.size(); j++) {
+					if (pattern[j] == '[' && set_end(pattern, j) != 0)
+						j = set_end(pattern, j) - 1;
+					else if (pattern[j] == '{')
+						depth++;
+					else if (pattern[j] == '}' && depth-- == 0)
+						break;
+					else if (pattern[j] == ',' && depth == 0)
+						return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	/// Star-backtracking matcher for patterns known at compile time; same semantics as `wildcard_matcher`.
+	constexpr bool wildcard_match(std::string_view pattern, std::string_view name) {
+		const std::size_t m = pattern.size();
+		std::size_t pi = 0, ni = 0;
+		std::size_t star_pi = std::string_view::npos, star_ni = 0;
+
+		while (ni < name.size()) {
+			if (pi < m && pattern[pi] == '*') {
+				while (pi < m && pattern[pi] == '*')
+					pi++;
+				star_pi = pi;
+				star_ni = ni;
+				continue;
+			}
+			if (pi < m) {
+				const char c = pattern[pi];
+				std::size_t next = pi + 1;
+				bool ok;
+				if (c == '?') {
+					ok = true;
+				}
+				else if (c == '[' && set_end(pattern, pi) != 0) {
+					next = set_end(pattern, pi);
+					ok = set_check(pattern, pi, next, (unsigned char)name[ni]) > 0;
+				}
+				else {
+					ok = (name[ni] == c);
+				}
+				if (ok) {
+					pi = next;
+					ni++;
+					continue;
+				}
+			}
+			if (star_pi == std::string_view::npos)
+				return false;
+			pi = star_pi;
+			ni = ++star_ni;
+		}
+		while (pi < m && pattern[pi] == '*')
+			pi++;
+		return pi == m;
+	}
+
+	/// The shape of a wildcard pattern, which determines the specialized matcher `static_pattern` uses for it.
+	struct static_shape {
+		enum kind_t {
+			exact,            // "CMakeLists.txt"
+			any,              // "*"
+			prefix,           // "lib*"
+			suffix,           // "*.json"
+			prefix_suffix,    // "lib*.so"
+			infix,            // "*test*"
+			generic,          // anything using '?', '[...]' or more stars
+		} kind;
+
+		std::size_t prefix_len;
+		std::size_t suffix_len;
+		std::size_t infix_pos;
+		std::size_t infix_len;
+	};
+
+	constexpr static_shape analyze_wildcard(std::string_view pattern) {
+		static_shape shape{static_shape::generic, 0, 0, 0, 0};
+		if (pattern.find_first_of("?[") != std::string_view::npos)
+			return shape;
+
+		const std::size_t first = pattern.find('*');
+		if (first == std::string_view::npos) {
+			shape.kind = static_shape::exact;
+			return shape;
+		}
+		const std::size_t last = pattern.rfind('*');
+		const std::string_view stars = pattern.substr(first, last - first + 1);
+		shape.prefix_len = first;
+		shape.suffix_len = pattern.size() - last - 1;
+
+		if (stars.find_first_not_of('*') == std::string_view::npos) {
+			if (shape.prefix_len == 0 && shape.suffix_len == 0)
+				shape.kind = static_shape::any;
+			else if (shape.prefix_len == 0)
+				shape.kind = static_shape::suffix;
+			else if (shape.suffix_len == 0)
+				shape.kind = static_shape::prefix;
+			else
+				shape.kind = static_shape::prefix_suffix;
+			return shape;
+		}
+
+		if (shape.prefix_len == 0 && shape.suffix_len == 0) {
+			const std::size_t begin = stars.find_first_not_of('*');
+			const std::size_t end = stars.find_last_not_of('*') + 1;
+			if (stars.substr(begin, end - begin).find('*') == std::string_view::npos) {
+				shape.kind = static_shape::infix;
+				shape.infix_pos = first + begin;
+				shape.infix_len = end - begin;
+			}
+		}
+		return shape;
+	}
+
+	/// The matcher for `Pattern.view().substr(Begin)`, specialized for its shape at compile time.
+	template <fixed_string Pattern, std::size_t Begin>
+	struct specialized_matcher {
+		static constexpr std::string_view pattern = Pattern.view().substr(Begin);
+		static constexpr static_shape shape = analyze_wildcard(pattern);
+
+		static constexpr bool match(std::string_view name) noexcept {
+			if constexpr (shape.kind == static_shape::exact) {
+				return name == pattern;
+			}
+			else if constexpr (shape.kind == static_shape::any) {
+				return true;
+			}
+			else if constexpr (shape.kind == static_shape::prefix) {
+				return name.substr(0, shape.prefix_len) == pattern.substr(0, shape.prefix_len);
+			}
+			else if constexpr (shape.kind == static_shape::suffix) {
+				return name.size() >= shape.suffix_len && name.substr(name.size() - shape.suffix_len) == pattern.substr(pattern.size() - shape.suffix_len);
+			}
+			else if constexpr (shape.kind == static_shape::prefix_suffix) {
+				return name.size() >= shape.prefix_len + shape.suffix_len &&
+					name.substr(0, shape.prefix_len) == pattern.substr(0, shape.prefix_len) &&
+					name.substr(name.size() - shape.suffix_len) == pattern.substr(pattern.size() - shape.suffix_len);
+			}
+			else if constexpr (shape.kind == static_shape::infix) {
+				return name.find(pattern.substr(shape.infix_pos, shape.infix_len)) != std::string_view::npos;
+			}
+			else {
+				return wildcard_match(pattern, name);
+			}
+		}
+	};
+
+} // namespace detail
+
+/// A wildcard pattern known at compile time, e.g. `glob::static_pattern<"**/*.proto">`.
+///
+/// The pattern is validated at compile time and gets a matcher specialized for its shape, e.g. a plain suffix compare
+/// for "*.json", so there's no runtime compilation nor generic matcher dispatch.
+/// `match()` matches the entire pattern (as `filter()` does), `element_match()` only its last path element (as `glob()` does).
+template <fixed_string Pattern>
+struct static_pattern {
+	static_assert(detail::is_valid_wildcard(Pattern.view()), "glob::static_pattern: unterminated `[...]` set or reversed range in the pattern");
+	static_assert(!detail::has_brace_alternatives(Pattern.view()), "glob::static_pattern: `{a,b}` alternatives are not supported, use a static_pattern per alternative");
+
+	static constexpr std::string_view text = Pattern.view();
+	static constexpr std::size_t element_begin = (text.find_last_of('/') == std::string_view::npos ? 0 : text.find_last_of('/') + 1);
+	static constexpr std::string_view element = text.substr(element_begin);
+
+	static constexpr bool match(std::string_view name) noexcept {
+		return detail::specialized_matcher<Pattern, 0>::match(name);
+	}
+
+	static constexpr bool element_match(std::string_view name) noexcept {
+		return detail::specialized_matcher<Pattern, element_begin>::match(name);
+	}
+
+	/// The matcher for the last path element, for `options::precompiled_matchers`.
+	static wildcard_matcher matcher() {
+		return wildcard_matcher(element, &element_match);
+	}
+};
+
+/// `glob(options&)` for `pattern` in `basepath`, using the compile-time specialized matcher for its last path element.
+template <fixed_string Pattern>
+std::vector<fs::path> glob(const fs::path &basepath, static_pattern<Pattern> pattern, bool recursive_search = true) {
+	options spec(basepath, std::string(pattern.text), recursive_search);
+	spec.precompiled_matchers.push_back(pattern.matcher());
+	return glob(spec);
+}
+
+/// `filter()` for a pattern known at compile time.
+template <fixed_string Pattern>
+std::vector<fs::path> filter(const std::vector<fs::path> &names, static_pattern<Pattern> pattern) {
+	std::vector<fs::path> result;
+	for (const auto &name : names) {
+		if (pattern.match(name.string())) {
+			result.push_back(name);
+		}
+	}
+	return result;
+}
+
+#endif
 
 fs::path mk_relative(const fs::path& p,const fs::path& base);
 
@@ -1,14 +1,72 @@
 #include <glob/glob.h>
 
 #include <cassert>
+#include <climits>
 
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <optional>
 #include <regex>
 #include <string_view>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
 #include <format>
+#include <unordered_map>
 #include <unordered_set>
 
+#if defined(__linux__)
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/magic.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#define GLOB_HAS_NATIVE_DIRECTORY_READER  1
+
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+
+#define GLOB_HAS_IO_URING  1
+#endif
+#else
+#define GLOB_HAS_NATIVE_DIRECTORY_READER  0
+#endif
+
+#ifndef GLOB_HAS_IO_URING
+#define GLOB_HAS_IO_URING  0
+#endif
+
+#if defined(GLOB_USE_NATIVE_DIRECTORY_READER)
+#define GLOB_NATIVE_DIRECTORY_READER_DEFAULT  GLOB_HAS_NATIVE_DIRECTORY_READER
+#else
+#define GLOB_NATIVE_DIRECTORY_READER_DEFAULT  0
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GLOB_SIMD_AVX2  1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GLOB_SIMD_SSE2  1
+#endif
+
 #define DO_DEBUG  0
 
 namespace glob {
@@ -172,18 +230,153 @@ namespace glob {
 			return path;
 		}
 
-		bool has_magic(const std::string &pathname) {
-			static const auto magic_check = std::regex("([*?[])");
-			return std::regex_search(pathname, magic_check);
+		bool has_magic(const fs::path &path) noexcept {
+			// inspect the native representation directly: no need to convert to std::string just to look for the wildcard characters.
+			const auto &native = path.native();
+			return std::any_of(native.begin(), native.end(), [](auto c) {
+				return c == '*' || c == '?' || c == '[';
+			});
 		}
 
-		bool has_magic(const fs::path &path) {
-			auto pathname = path.string();
-			return has_magic(pathname);
+		// \return whether `path` contains characters which have case: ASCII letters or anything beyond 7-bit ASCII.
+		// The root name is skipped, e.g. the drive letter in "C:/src".
+		bool has_cased(const fs::path &path) noexcept {
+			const auto &native = path.native();
+			const std::size_t skip = path.root_name().native().size();
+			return std::any_of(native.begin() + skip, native.end(), [](auto c) {
+				return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c & ~0x7F) != 0;
+			});
+		}
+
+		constexpr bool has_flag(match_flags flags, match_flags flag) noexcept {
+			return (flags & flag) != match_flags::none;
+		}
+
+		// \return whether `path` contains an extglob group, e.g. "@(a|b)". The "?(" and "*(" groups are covered by `has_magic()`.
+		bool has_extglob(const fs::path &path) noexcept {
+			const auto &native = path.native();
+			for (std::size_t i = 0; i + 1 < native.size(); i++) {
+				if (native[i + 1] == '(' && (native[i] == '+' || native[i] == '@' || native[i] == '!'))
+					return true;
+			}
+			return false;
+		}
+
+		// `case_insensitive` runs cannot look up a literal path element which has case directly: it has to be
+		// matched against its parent directory listing, just like a wildcard.
+		bool needs_matching(const fs::path &path, match_flags flags) noexcept {
+			return has_magic(path) ||
+				(has_flag(flags, match_flags::case_insensitive) && has_cased(path)) ||
+				(has_flag(flags, match_flags::extglob) && has_extglob(path));
+		}
+
+		// \return the index just past the `[...]` set starting at `pattern[i] == '['`, or 0 when it is not terminated.
+		std::size_t skip_set(std::string_view pattern, std::size_t i) noexcept {
+			std::size_t j = i + 1;
+			if (j < pattern.size() && pattern[j] == '!')
+				j++;
+			if (j < pattern.size() && pattern[j] == ']')
+				j++;
+			while (j < pattern.size() && pattern[j] != ']')
+				j++;
+			return j < pattern.size() ? j + 1 : 0;
+		}
+
+		// Locate the end of the brace group starting at `pattern[open] == '{'` and its top-level ',' separators.
+		// \return false when this is not a brace expansion: unterminated or, as in the shell, without a ',' (e.g. "{a}").
+		bool find_brace_group(std::string_view pattern, std::size_t open, std::vector<std::size_t> &commas, std::size_t &close) {
+			commas.clear();
+			int depth = 0;
+			for (std::size_t i = open + 1; i < pattern.size(); i++) {
+				const char c = pattern[i];
+				if (c == '[') {
+					const std::size_t end = skip_set(pattern, i);
+					if (end != 0)
+						i = end - 1;
+				}
+				else if (c == '{') {
+					depth++;
+				}
+				else if (c == '}') {
+					if (depth == 0) {
+						close = i;
+						return !commas.empty();
+					}
+					depth--;
+				}
+				else if (c == ',' && depth == 0) {
+					commas.push_back(i);
+				}
+			}
+			return false;
+		}
+
+		// Shell-style brace expansion: "src/{a,b}/*.{c,h}" expands to "src/a/*.c", "src/a/*.h", "src/b/*.c" and "src/b/*.h".
+		// Groups may be nested. `expand(pattern, open, close)` decides per group whether it is expanded here; the others are left as is.
+		template <typename Predicate>
+		void expand_braces(std::string_view pattern, std::vector<std::string> &out, Predicate expand) {
+			std::vector<std::size_t> commas;
+			std::size_t close = 0;
+			for (std::size_t i = 0; i < pattern.size(); i++) {
+				if (pattern[i] == '[') {
+					const std::size_t end = skip_set(pattern, i);
+					if (end != 0)
+						i = end - 1;
+					continue;
+				}
+				if (pattern[i] != '{' || !find_brace_group(pattern, i, commas, close))
+					continue;
+				if (!expand(pattern, i, close)) {
+					i = close;
+					continue;
+				}
+
+				// expand this group; the groups which follow are taken care of by the recursion.
+				commas.push_back(close);
+				std::size_t from = i + 1;
+				for (std::size_t end : commas) {
+					std::string alternative;
+					alternative.reserve(pattern.size());
+					alternative.append(pattern.substr(0, i)).append(pattern.substr(from, end - from)).append(pattern.substr(close + 1));
+					expand_braces(alternative, out, expand);
+					from = end + 1;
+				}
+				return;
+			}
+			out.emplace_back(pattern);
+		}
+
+		template <typename Char>
+		constexpr bool is_separator(Char c) noexcept {
+			return c == Char('/') || c == Char(fs::path::preferred_separator);
+		}
+
+		// The brace groups of a search spec which are expanded into separate paths: those spanning path elements, e.g. "{src,test/unit}",
+		// and those in an element without any wildcards, e.g. "{core,net}", which become literal lookups. The others, e.g. "*.{cpp,h}",
+		// are left to the matcher of their path element, so the directory is listed once for all their alternatives.
+		bool is_path_brace_group(std::string_view spec, std::size_t open, std::size_t close) {
+			std::size_t begin = open, end = close;
+			while (begin > 0 && !is_separator(spec[begin - 1]))
+				begin--;
+			while (end < spec.size() && !is_separator(spec[end]))
+				end++;
+			const std::string_view body = spec.substr(open, close - open);
+			const std::string_view element = spec.substr(begin, end - begin);
+			return std::any_of(body.begin(), body.end(), is_separator<char>) || element.find_first_of("*?[") == std::string_view::npos;
+		}
+
+		// \return the search specs `spec` expands to, see `is_path_brace_group()`: only `spec` itself without `match_flags::brace_expansion`.
+		std::vector<fs::path> expand_spec_braces(const fs::path &spec, match_flags flags) {
+			const std::string text = spec.string();
+			if (!has_flag(flags, match_flags::brace_expansion) || text.find('{') == std::string::npos)
+				return {spec};
+			std::vector<std::string> expanded;
+			expand_braces(text, expanded, is_path_brace_group);
+			return std::vector<fs::path>(expanded.begin(), expanded.end());
 		}
 
 		constexpr bool is_hidden(std::string_view pathname) noexcept {
-			return pathname[0] == '.';
+			return !pathname.empty() && pathname.front() == '.';
 		}
 
 		bool is_hidden(const fs::path &path) noexcept {
@@ -204,842 +397,4171 @@ namespace glob {
 			return pattern == "**";
 		}
 
-		std::vector<fs::path> iter_directory(const fs::path &dirname, bool dironly) {
-			std::vector<fs::path> result;
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+		// the record layout produced by the getdents64 system call (glibc does not export it under this name).
+		struct linux_dirent64 {
+			ino64_t d_ino;
+			off64_t d_off;
+			unsigned short d_reclen;
+			unsigned char d_type;
+			char d_name[];
+		};
+#endif
 
-			auto current_directory = dirname;
-			if (current_directory.empty()) {
-				current_directory = fs::current_path();
-			}
+		static constexpr std::size_t DIRENT_BUFFER_SIZE = 64 * 1024;
 
-			if (fs::exists(current_directory)) {
-				try {
-					for (auto &entry : fs::directory_iterator(
-						current_directory, fs::directory_options::follow_directory_symlink |
-						fs::directory_options::skip_permission_denied)) {
-						if (!dironly || entry.is_directory()) {
-							if (dirname.is_absolute()) {
-								result.push_back(entry.path());
-							} 
-							else {
-								result.push_back(fs::relative(entry.path()));
-							}
-						}
+		// `dedup_mode::file`: a file is identified by its device and inode number.
+		struct file_id {
+			std::uint64_t device;
+			std::uint64_t inode;
+
+			friend bool operator==(const file_id &a, const file_id &b) = default;
+		};
+
+#if GLOB_HAS_IO_URING
+		static constexpr unsigned STATX_RING_SIZE = 256;
+		static constexpr unsigned OPEN_PREFETCH_RING_SIZE = 16;
+
+		// An io_uring, set up with the raw system calls: requests are pushed into the submission queue, handed to the kernel by
+		// `submit()` and their completions collected by `wait()`.
+		//
+		// When the setup fails (older kernels, io_uring disabled or blocked by a seccomp policy) or the kernel refuses a request,
+		// `ok()` turns false and the users fall back to plain system calls.
+		class io_ring {
+		public:
+			explicit io_ring(unsigned entries) {
+				io_uring_params params{};
+				ring_fd = (int)::syscall(__NR_io_uring_setup, entries, &params);
+				if (ring_fd < 0)
+					return;
+
+				sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+				cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+				const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+				if (single_mmap) {
+					sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+				}
+
+				sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+				if (sq_ring == MAP_FAILED) {
+					sq_ring = nullptr;
+					shutdown();
+					return;
+				}
+				if (single_mmap) {
+					cq_ring = sq_ring;
+				}
+				else {
+					cq_ring = ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+					if (cq_ring == MAP_FAILED) {
+						cq_ring = nullptr;
+						shutdown();
+						return;
 					}
 				}
-				catch (std::exception&) {
-					// not a directory
-					// do nothing
+				sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+				void *sqe_map = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+				if (sqe_map == MAP_FAILED) {
+					shutdown();
+					return;
 				}
+				sqes = static_cast<io_uring_sqe *>(sqe_map);
+
+				char *sq = static_cast<char *>(sq_ring);
+				sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+				sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+				sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+				sq_entries = params.sq_entries;
+
+				char *cq = static_cast<char *>(cq_ring);
+				cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+				cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+				cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+				cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
 			}
 
-			return result;
-		}
+			~io_ring() {
+				shutdown();
+			}
 
-		// Recursively yields relative pathnames inside a literal directory.
-		std::vector<fs::path> rlistdir(const fs::path &dirname, bool dironly) {
-			std::vector<fs::path> result;
-			//std::cout << "rlistdir: " << dirname.string() << "\n";
-			auto names = iter_directory(dirname, dironly);
-			for (auto &&name : names) {
-				if (!is_hidden(name)) {
-					result.push_back(name);
-					auto matched_dirs = rlistdir(name, dironly);
-					std::copy(std::make_move_iterator(matched_dirs.begin()), std::make_move_iterator(matched_dirs.end()), std::back_inserter(result));
-				}
+			io_ring(const io_ring &) = delete;
+			io_ring &operator=(const io_ring &) = delete;
+
+			bool ok() const noexcept {
+				return ring_fd >= 0;
 			}
-			return result;
-		}
 
-		// This helper function recursively yields relative pathnames inside a literal
-		// directory.
-		std::vector<fs::path> glob2(const fs::path &dirname, [[maybe_unused]] const fs::path &pattern,
-																bool dironly) {
-			// std::cout << "In glob2\n";
-			std::vector<fs::path> result{"."};
-			assert(is_recursive(pattern));
-			auto matched_dirs = rlistdir(dirname, dironly);
-			std::copy(std::make_move_iterator(matched_dirs.begin()), std::make_move_iterator(matched_dirs.end()), std::back_inserter(result));
-			return result;
-		}
+			// \return whether another request fits in the ring, counting those in flight and those pushed but not yet submitted.
+			bool has_room() const noexcept {
+				return in_flight + pushed < sq_entries;
+			}
 
-		// These 2 helper functions non-recursively glob inside a literal directory.
-		// They return a list of basenames.  _glob1 accepts a pattern while _glob0
-		// takes a literal basename (so it only has to check for its existence).
+			unsigned requests_in_flight() const noexcept {
+				return in_flight;
+			}
 
-		std::vector<fs::path> glob1(const fs::path &dirname, const fs::path &pattern,
-																bool dironly) {
-			// std::cout << "In glob1\n";
-			std::vector<fs::path> filtered_names;
-			auto names = iter_directory(dirname, dironly);
-			for (auto &&name : names) {
-				if (!is_hidden(name)) {
-					filtered_names.push_back(name.filename());
-					// if (name.is_relative()) {
-					//   // std::cout << "Filtered (Relative): " << name << "\n";
-					//   filtered_names.push_back(fs::relative(name));
-					// } else {
-					//   // std::cout << "Filtered (Absolute): " << name << "\n";
-					//   filtered_names.push_back(name.filename());
-					// }
-				}
+			// queue `sqe` for the next `submit()`; the caller checks `has_room()` first.
+			void push(const io_uring_sqe &sqe) {
+				const unsigned index = (*sq_tail + pushed) & sq_mask;
+				sqes[index] = sqe;
+				sq_array[index] = index;
+				pushed++;
 			}
-			return filter(filtered_names, pattern.string());
-		}
 
-		std::vector<fs::path> glob0(const fs::path &dirname, const fs::path &basename,
-																bool /*dironly*/) {
-			// std::cout << "In glob0\n";
+			// hand the pushed requests to the kernel, without waiting for them.
+			bool submit() {
+				if (pushed == 0)
+					return ok();
+				__atomic_store_n(sq_tail, *sq_tail + pushed, __ATOMIC_RELEASE);
+				const unsigned count = pushed;
+				pushed = 0;
+				if (enter(count, 0) < 0) {
+					shutdown();
+					return false;
+				}
+				in_flight += count;
+				return true;
+			}
 
-			// 'q*x/' should match only directories.
-			if ((basename.empty() && fs::is_directory(dirname)) || (!basename.empty() && fs::exists(dirname / basename))) {
-				return {basename};
+			// wait for at least one request to complete and pass every completion to `done(user_data, res)`.
+			template <typename Done>
+			bool wait(Done &&done) {
+				if (in_flight == 0 || enter(0, 1) < 0)
+					return false;
+				unsigned head = *cq_head;
+				const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+				while (head != tail) {
+					const io_uring_cqe &cqe = cqes[head & cq_mask];
+					done(cqe.user_data, cqe.res);
+					in_flight--;
+					head++;
+				}
+				__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+				return true;
 			}
-			return {};
-		}
 
-		std::vector<fs::path> glob(const fs::path &pathspec, bool recursive = false,
-															 bool dironly = false) {
-			std::vector<fs::path> result;
+			void shutdown() {
+				if (sqes)
+					::munmap(sqes, sqes_size);
+				if (cq_ring && cq_ring != sq_ring)
+					::munmap(cq_ring, cq_ring_size);
+				if (sq_ring)
+					::munmap(sq_ring, sq_ring_size);
+				sqes = nullptr;
+				cq_ring = sq_ring = nullptr;
+				// closing the ring cancels whatever is still in flight and waits for it.
+				if (ring_fd >= 0)
+					::close(ring_fd);
+				ring_fd = -1;
+				in_flight = 0;
+				pushed = 0;
+			}
 
-			fs::path path = pathspec;
+		private:
+			int enter(unsigned to_submit, unsigned min_complete) {
+				for (;;) {
+					long rv = ::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+					if (rv >= 0 || errno != EINTR)
+						return (int)rv;
+				}
+			}
 
-			path = expand_tilde(path);
+			int ring_fd = -1;
+			void *sq_ring = nullptr;
+			void *cq_ring = nullptr;
+			io_uring_sqe *sqes = nullptr;
+			std::size_t sq_ring_size = 0;
+			std::size_t cq_ring_size = 0;
+			std::size_t sqes_size = 0;
+
+			unsigned *sq_tail = nullptr;
+			unsigned *sq_array = nullptr;
+			unsigned sq_mask = 0;
+			unsigned sq_entries = 0;
+			unsigned *cq_head = nullptr;
+			unsigned *cq_tail = nullptr;
+			unsigned cq_mask = 0;
+			io_uring_cqe *cqes = nullptr;
+
+			unsigned in_flight = 0;
+			unsigned pushed = 0;
+		};
 
-			auto dirname = path.parent_path();
-			const auto basename = path.filename().string();
-			auto pathname = path.string();
+		// Resolves the type of the entries in a getdents64 buffer which `d_type` doesn't tell us about (`DT_LNK`, `DT_UNKNOWN`) with
+		// `statx()` requests submitted to an io_uring in one go: the kernel works on them while the other entries are being matched.
+		// When the ring is unavailable or the kernel rejects the statx operation, `ok()` turns false and the caller falls back to
+		// plain `fstatat()` calls.
+		class statx_batch {
+		public:
+			statx_batch()
+				: ring(STATX_RING_SIZE)
+			{}
+
+			~statx_batch() {
+				// the kernel may still be writing into `results`.
+				drain();
+			}
 
-			if (!has_magic(pathname)) {
-				assert(!dironly);
+			statx_batch(const statx_batch &) = delete;
+			statx_batch &operator=(const statx_batch &) = delete;
 
-				// Patterns ending with a slash should match only directories
-				if ((!basename.empty() && fs::exists(path)) || (basename.empty() && fs::is_directory(dirname))) {
-					result.push_back(path);
-				}
-				return result;
+			bool ok() const noexcept {
+				return ring.ok();
 			}
 
-			if (dirname.empty()) {
-				if (recursive && is_recursive(basename)) {
-					return glob2(dirname, basename, dironly);
-				}
-				return glob1(dirname, basename, dironly);
+			// start a new batch for the entries of directory `dirfd`; any requests still in flight are waited for first.
+			void reset(int dirfd) {
+				drain();
+				fd = dirfd;
+				names.clear();
+				status.clear();
+				submitted = 0;
 			}
 
-			std::vector<fs::path> dirs{dirname};
-			if (dirname != fs::path(pathname) && has_magic(dirname.string())) {
-				dirs = glob(dirname, recursive, true);
+			// queue a statx request for `name`, which must stay valid until the batch is reset. Returns the slot of the result.
+			int add(const char *name) {
+				names.push_back(name);
+				status.push_back(PENDING);
+				return (int)names.size() - 1;
 			}
 
-			auto glob_in_dir = glob0;
-			if (has_magic(basename)) {
-				if (recursive && is_recursive(basename)) {
-					glob_in_dir = glob2;
-				} 
-				else {
-					glob_in_dir = glob1;
+			// hand the queued requests to the kernel, as far as they fit, without waiting for them.
+			void submit() {
+				if (!ok())
+					return;
+				results.resize(names.size());		// no reallocation happens while requests are in flight: they're only added between batches.
+
+				while (submitted < (int)names.size() && ring.has_room()) {
+					io_uring_sqe sqe{};
+					sqe.opcode = IORING_OP_STATX;
+					sqe.fd = fd;
+					sqe.addr = (unsigned long)names[submitted];
+					sqe.len = STATX_TYPE | STATX_MODE | STATX_INO;
+					sqe.off = (unsigned long)&results[submitted];
+					sqe.user_data = (unsigned)submitted;
+					ring.push(sqe);
+					submitted++;
 				}
+				// requests which didn't make it will be served by fstatat()
+				ring.submit();
 			}
 
-			for (auto &d : dirs) {
-				for (auto &&name : glob_in_dir(d, basename, dironly)) {
-					fs::path subresult = name;
-					if (name.parent_path().empty()) {
-						subresult = d / name;
+			// \return the result for `slot`: 1 = directory, 0 = not a directory, -1 = not resolved, i.e. the caller must stat the entry itself.
+			int wait(int slot) {
+				while (status[slot] == PENDING && ok()) {
+					// with the ring full, submit() makes no progress until a completion has been reaped.
+					if (slot >= submitted) {
+						const int before = submitted;
+						submit();
+						if (submitted > before)
+							continue;
 					}
-					result.push_back(subresult.lexically_normal());
+					if (!ring.wait([this](std::uint64_t user_data, int res) { reap(user_data, res); }))
+						break;
 				}
-			}
 
-			return result;
-		}
+				const int res = status[slot];
+				if (res == -EINVAL || res == -EOPNOTSUPP) {
+					// the kernel supports io_uring, but not IORING_OP_STATX: don't bother trying again.
+					drain();
+					ring.shutdown();
+				}
+				if (res == 0)
+					return S_ISDIR(results[slot].stx_mode) ? 1 : 0;
+				// fstatat() would fail just the same for these, e.g. a broken symlink:
+				if (res == -ENOENT || res == -ELOOP || res == -ENOTDIR || res == -EACCES)
+					return 0;
+				return -1;
+			}
 
-		std::vector<fs::path> glob(const std::string& pathname, bool recursive = false,
-			bool dironly = false) {
-			return glob(fs::path(pathname), recursive, dironly);
-		}
+			// \return the device and inode number of the entry in `slot`, once wait() has resolved it.
+			std::optional<file_id> identify(int slot) const {
+				if (status[slot] != 0)
+					return std::nullopt;
+				const struct statx &st = results[slot];
+				return file_id{(std::uint64_t)makedev(st.stx_dev_major, st.stx_dev_minor), st.stx_ino};
+			}
 
-		struct searchspec {
-			fs::path basepath;		// the non-wildcarded base
-			fs::path deep_spec;   // the rest of the searchspec; may contain wildcards
+			// wait for all requests in flight, as they still refer to the caller's buffers.
+			void drain() {
+				while (ring.requests_in_flight() > 0 && ok()) {
+					if (!ring.wait([this](std::uint64_t user_data, int res) { reap(user_data, res); })) {
+						ring.shutdown();
+						break;
+					}
+				}
+			}
 
-			bool accepts_directories_only;		// when the search spec ended in a '/', that signaled the user only wishes to receive directory entries.
+		private:
+			static constexpr int PENDING = 1;
 
-			bool basepath_exists;							// flag/cache to help reduce the number of system calls during a scan: when `true`, we already know `fs::exists(basepath)` is true.
+			void reap(std::uint64_t user_data, int res) {
+				if (user_data < status.size())
+					status[user_data] = (res > 0 ? -EIO : res);
+			}
 
-			int actual_depth;
-			int max_recursion_depth;  // -1 means: unlimited depth
+			io_ring ring;
 
-			int original_spec_index;
+			int fd = -1;
+			std::vector<const char *> names;
+			std::vector<struct statx> results;
+			std::vector<int> status;
+			int submitted = 0;
 		};
 
-		struct cached_options {
-			fs::path basepath;
-			std::vector<searchspec> searchpaths;
-			int searchpath_index = -1;
-
-			int item_count_scanned = 0;
-			int dir_count_scanned = 0;
+		// `options::use_io_uring`: opens the directories which are next in line for scanning ahead of time, with `openat()` requests
+		// the kernel works on while the current directory is being listed and matched. `open_directory()` then claims the descriptor.
+		class open_prefetch {
+		public:
+			open_prefetch()
+				: ring(OPEN_PREFETCH_RING_SIZE)
+			{}
+
+			~open_prefetch() {
+				drain();
+				for (auto &[path, request] : requests) {
+					if (request->result >= 0)
+						::close(request->result);
+				}
+			}
 
-			bool report_100pct_done_pending = true;
+			open_prefetch(const open_prefetch &) = delete;
+			open_prefetch &operator=(const open_prefetch &) = delete;
 
-			std::vector<fs::path> result_set;
-			std::vector<std::string> error_msg;
-		};
+			bool ok() const noexcept {
+				return ring.ok();
+			}
 
-		bool report_100_pct_done(cached_options &cache, options &search_spec) {
-			if (cache.report_100pct_done_pending) {
-				cache.report_100pct_done_pending = false;
+			// \return whether another directory can be prefetched: opened descriptors count until they are claimed.
+			bool has_room() const noexcept {
+				return ok() && requests.size() < OPEN_PREFETCH_RING_SIZE && ring.has_room();
+			}
 
-				// report progress @ 100% done:
-				options::filter_info_t fi{
-					.basepath = cache.basepath,
-					//.item_relpath = "",
-					//.entry = nil,
+			// start opening `dir`, unless that has already been done.
+			void add(const fs::path &dir) {
+				auto [it, inserted] = requests.try_emplace(dir.native());
+				if (!inserted)
+					return;
+				it->second = std::make_unique<request>();
+
+				io_uring_sqe sqe{};
+				sqe.opcode = IORING_OP_OPENAT;
+				sqe.fd = AT_FDCWD;
+				sqe.addr = (unsigned long)it->first.c_str();		// unordered_map keys don't move
+				sqe.open_flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+				sqe.user_data = (unsigned long)it->second.get();
+				ring.push(sqe);
+			}
 
-					//.matching_wildcarded_fragment = "",
-					//.subsearch_spec = "",
+			// hand the added requests to the kernel.
+			void submit() {
+				if (!ring.submit())
+					abandon();
+			}
 
-					.fragment_is_wildcarded = false,
-					.fragment_is_double_star = false,
+			// \return the prefetched descriptor for `dir` (waiting for it when needed), `-errno` when opening it failed, or nothing
+			// when it wasn't prefetched.
+			std::optional<int> take(const fs::path &dir) {
+				auto it = requests.find(dir.native());
+				if (it == requests.end())
+					return std::nullopt;
+				while (it->second->result == PENDING) {
+					if (!ring.wait([](std::uint64_t user_data, int res) { reinterpret_cast<request *>(user_data)->result = res; })) {
+						abandon();
+						return std::nullopt;
+					}
+				}
+				const int result = it->second->result;
+				requests.erase(it);
+				if (result == -EINVAL || result == -EOPNOTSUPP) {
+					// the kernel supports io_uring, but not IORING_OP_OPENAT: open the directories one by one again.
+					drain();
+					ring.shutdown();
+					abandon();
+					return std::nullopt;
+				}
+				return result;
+			}
 
-					//.userland_may_override_accept = true,
-					.userland_may_override_recurse_into = false,
+		private:
+			static constexpr int PENDING = INT_MIN;
 
-					.is_directory = false,
-					.is_hidden = false,
+			struct request {
+				int result = PENDING;
+			};
 
-					.depth = -1,
-					.max_recursion_depth = -1,
+			void drain() {
+				while (ring.requests_in_flight() > 0) {
+					if (!ring.wait([](std::uint64_t user_data, int res) { reinterpret_cast<request *>(user_data)->result = res; }))
+						break;
+				}
+			}
 
-					.item_count_scanned = cache.item_count_scanned,
-					.dir_count_scanned = cache.dir_count_scanned,
+			// the ring failed: forget about the requests which haven't completed, closing the ring has cancelled them.
+			void abandon() {
+				ring.shutdown();
+				std::erase_if(requests, [](const auto &item) {
+					return item.second->result == PENDING;
+				});
+			}
 
-					.original_search_spec_index = -1,
-					.actual_search_spec_index = (int)cache.searchpaths.size(),
-					.search_spec_count = (int)cache.searchpaths.size(),
-				};
-				options::filter_state_t fs{
-					.accept = false,
-					.recurse_into = false,
-					.stop_scan_for_this_spec = false,
-					.do_report_progress = true,
-				};
+			io_ring ring;
+			std::unordered_map<fs::path::string_type, std::unique_ptr<request>> requests;
+		};
+#else
+		// placeholder for platforms without io_uring: never `ok()`.
+		class statx_batch {
+		public:
+			bool ok() const noexcept {
+				return false;
+			}
+		};
 
-				if (fs.do_report_progress) {
-					if (!search_spec.progress_reporting(fi, fs))
-						return false;
-				}
+		class open_prefetch {
+		public:
+			bool ok() const noexcept {
+				return false;
 			}
-			return false;
-		}
+		};
+#endif
 
-		bool glob_42(cached_options &cache, options &search_spec) {
-			// preparation / init phase
-			if (cache.searchpath_index < 0) {
-				cache.basepath = search_spec.basepath;
-				if (!cache.basepath.empty())
-					cache.basepath = expand_tilde(cache.basepath);
-
-				for (int index = 0; index < search_spec.pathnames.size(); index++) {
-					fs::path pn = search_spec.pathnames[index];
-					pn = expand_tilde(pn);
-					bool is_rel = pn.is_relative();
-
-					if (pn.empty()) {
-						pn = fs::current_path();
-						is_rel = false;
+		// Lists a single directory, using either `fs::directory_iterator` or, on Linux, the raw `getdents64()` system call.
+		//
+		// The native reader trusts the `d_type` reported by the kernel, so no stat is needed per entry: `fstatat()` is only called
+		// for `DT_UNKNOWN` (file systems which don't fill in the type) and `DT_LNK` (a symlink to a directory counts as a directory,
+		// just like `fs::directory_entry::is_directory()` says).
+		// Permission denied errors produce an empty listing, as with `fs::directory_options::skip_permission_denied`.
+		class directory_reader {
+		public:
+			// `buffer` is the reusable getdents64 buffer; it is only touched by the native reader.
+			directory_reader(const fs::path &dirname, bool native, std::vector<char> &buffer)
+				: dirname(dirname),
+				buffer(buffer)
+			{
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+				if (native) {
+					use_native = true;
+					fd = ::open(dirname.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+					if (fd < 0 && errno != EACCES) {
+						throw fs::filesystem_error("cannot open directory", dirname, std::error_code(errno, std::generic_category()));
 					}
-
-					int max_depth = search_spec.max_recursion_depth[index];
-					if (max_depth < 0)
-						max_depth = INT_MAX;
-
-					// help detect whether the search spec ended with an '/' or equivalent directory separator:
-					const auto basename = pn.filename().string();
-
-					searchspec spec{
-						.basepath = (is_rel ? cache.basepath : ""),
-						.deep_spec = pn,
-						.accepts_directories_only = basename.empty(),
-						.basepath_exists = false,
-						.actual_depth = 0,
-						.max_recursion_depth = max_depth,
-						.original_spec_index = index,
-					};
-					cache.searchpaths.push_back(spec);
+					owns_fd = true;
+					if (buffer.size() < DIRENT_BUFFER_SIZE) {
+						buffer.resize(DIRENT_BUFFER_SIZE);
+					}
+					return;
 				}
+#endif
+				iter = fs::directory_iterator(dirname, fs::directory_options::follow_directory_symlink |
+					fs::directory_options::skip_permission_denied);
+			}
 
-				cache.item_count_scanned = 0;
-				cache.dir_count_scanned = 0;
-
-				cache.report_100pct_done_pending = true;
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+			// native reader for the already opened directory `dirfd`, which remains owned by the caller. A negative `dirfd` produces an empty listing.
+			// When `batch` is provided, symlinks and entries of unknown type are resolved through it.
+			directory_reader(int dirfd, const fs::path &dirname, std::vector<char> &buffer, statx_batch *batch = nullptr)
+				: fd(dirfd),
+				batch(batch && batch->ok() ? batch : nullptr),
+				dirname(dirname),
+				buffer(buffer),
+				use_native(true)
+			{
+				if (buffer.size() < DIRENT_BUFFER_SIZE) {
+					buffer.resize(DIRENT_BUFFER_SIZE);
+				}
+			}
+#endif
 
-				cache.searchpath_index = 0;
+			~directory_reader() {
+#if GLOB_HAS_IO_URING
+				// the kernel may still be writing into our buffers.
+				if (batch)
+					batch->drain();
+#endif
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+				if (owns_fd && fd >= 0) {
+					::close(fd);
+				}
+#endif
 			}
 
-			if (cache.searchpath_index >= cache.searchpaths.size())
-				return report_100_pct_done(cache, search_spec);
+			directory_reader(const directory_reader &) = delete;
+			directory_reader &operator=(const directory_reader &) = delete;
+
+			// advance to the next entry; returns false once the directory has been exhausted.
+			bool next() {
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+				if (use_native) {
+					return next_native();
+				}
+#endif
+				if (started) {
+					++iter;
+				}
+				started = true;
+				if (iter == fs::directory_iterator{}) {
+					return false;
+				}
+				current_is_dir = iter->is_directory();
+				if constexpr (std::is_same_v<fs::path::value_type, char>) {
+					// the entry path is `dirname / filename`: view the name in place.
+					const std::string_view native{iter->path().native()};
+					const auto sep = native.find_last_of(fs::path::preferred_separator);
+					name_view = (sep == std::string_view::npos ? native : native.substr(sep + 1));
+				}
+				else {
+					current_name = iter->path().filename().string();
+					name_view = current_name;
+				}
+				return true;
+			}
+
+			// the name of the current entry; only valid until the next call to next().
+			std::string_view name() const noexcept {
+				return name_view;
+			}
+
+			bool is_directory() const noexcept {
+				return current_is_dir;
+			}
+
+			// the `fs::directory_entry` of the current entry, or NULL when the native reader is used.
+			const fs::directory_entry *entry() const noexcept {
+				return use_native ? nullptr : &*iter;
+			}
+
+			// `dedup_mode::file`: the device and inode number of the current entry, as far as the native reader learns them without a system
+			// call per entry: from `d_ino`, or from resolving a symlink. Not for directories: their `d_ino` is that of the directory underneath
+			// when another file system is mounted on them. Nor from `d_ino` on overlayfs, which may report the inode of another layer there.
+			std::optional<file_id> identify() {
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+				if (use_native && current_id) {
+					if (current_id->device == unknown_device) {
+						if (!directory_device) {
+							struct stat st;
+							struct statfs fs_info;
+							const bool trusted = (::fstat(fd, &st) == 0 && ::fstatfs(fd, &fs_info) == 0 && fs_info.f_type != OVERLAYFS_SUPER_MAGIC);
+							directory_device = (trusted ? (std::uint64_t)st.st_dev : unknown_device);
+						}
+						if (*directory_device == unknown_device)
+							return std::nullopt;
+						current_id->device = *directory_device;
+					}
+					return current_id;
+				}
+#endif
+				return std::nullopt;
+			}
+
+		private:
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+			bool next_native() {
+				if (fd < 0) {
+					return false;
+				}
+				for (;;) {
+					if (pos >= len) {
+						long n = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+						if (n < 0) {
+							throw fs::filesystem_error("cannot read directory", dirname, std::error_code(errno, std::generic_category()));
+						}
+						if (n == 0) {
+							return false;
+						}
+						pos = 0;
+						len = (std::size_t)n;
+#if GLOB_HAS_IO_URING
+						if (batch)
+							queue_statx_batch();
+#endif
+					}
+
+					const auto *d = reinterpret_cast<const linux_dirent64 *>(buffer.data() + pos);
+					pos += d->d_reclen;
+
+					const char *name = d->d_name;
+					if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+						continue;
+
+					name_view = std::string_view{name};
+					current_id.reset();
+					switch (d->d_type) {
+					case DT_DIR:
+						current_is_dir = true;
+						break;
+
+					case DT_LNK:
+					case DT_UNKNOWN:
+						{
+							int rv = -1;
+#if GLOB_HAS_IO_URING
+							if (batch) {
+								const int slot = next_slot++;
+								rv = batch->wait(slot);
+								if (rv >= 0)
+									current_id = batch->identify(slot);
+							}
+#endif
+							if (rv < 0) {
+								struct stat st;
+								const bool found = (::fstatat(fd, name, &st, 0) == 0);
+								rv = (found && S_ISDIR(st.st_mode));
+								if (found)
+									current_id = file_id{(std::uint64_t)st.st_dev, (std::uint64_t)st.st_ino};
+							}
+							current_is_dir = (rv == 1);
+							if (current_is_dir)
+								current_id.reset();
+						}
+						break;
+
+					default:
+						current_is_dir = false;
+						current_id = file_id{unknown_device, (std::uint64_t)d->d_ino};
+						break;
+					}
+					return true;
+				}
+			}
+
+#if GLOB_HAS_IO_URING
+			// submit a statx request for every entry in the freshly read buffer which `d_type` doesn't resolve; next_native()
+			// collects the results in the same order.
+			void queue_statx_batch() {
+				batch->reset(fd);
+				next_slot = 0;
+				for (std::size_t at = 0; at < len; ) {
+					const auto *d = reinterpret_cast<const linux_dirent64 *>(buffer.data() + at);
+					at += d->d_reclen;
+
+					const char *name = d->d_name;
+					if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+						continue;
+					if (d->d_type == DT_LNK || d->d_type == DT_UNKNOWN)
+						batch->add(name);
+				}
+				batch->submit();
+			}
+
+			int next_slot = 0;
+#endif
+
+			int fd = -1;
+			statx_batch *batch = nullptr;
+			bool owns_fd = false;
+			std::size_t pos = 0;
+			std::size_t len = 0;
+
+			// the id of the current entry: its device is the one of the directory, which is only looked up when asked for.
+			static constexpr std::uint64_t unknown_device = ~std::uint64_t(0);
+			std::optional<file_id> current_id;
+			std::optional<std::uint64_t> directory_device;
+#endif
+
+			const fs::path &dirname;
+			std::vector<char> &buffer;
+			bool use_native = false;
+
+			fs::directory_iterator iter;
+			bool started = false;
+			std::string current_name;
+
+			std::string_view name_view;
+			bool current_is_dir = false;
+		};
+
+		// `result_order::directory`: a complete directory listing, which is served in the (bytewise) order of the entry names
+		// rather than in the order the file system happens to list them.
+		struct sorted_listing {
+			std::string names;
+			std::vector<std::size_t> name_ends;
+			std::vector<bool> is_dir;
+			std::vector<fs::directory_entry> entries;		// empty when the directory is listed by the native directory reader
+			std::vector<std::optional<file_id>> ids;			// `dedup_mode::file` only
+
+			void add(directory_reader &reader, bool identify) {
+				names.append(reader.name());
+				name_ends.push_back(names.size());
+				is_dir.push_back(reader.is_directory());
+				if (reader.entry())
+					entries.push_back(*reader.entry());
+				if (identify)
+					ids.push_back(reader.identify());
+			}
+
+			std::string_view name(std::size_t index) const noexcept {
+				const std::size_t begin = (index ? name_ends[index - 1] : 0);
+				return std::string_view(names).substr(begin, name_ends[index] - begin);
+			}
+
+			const fs::directory_entry *entry(std::size_t index) const noexcept {
+				return entries.empty() ? nullptr : &entries[index];
+			}
+
+			std::optional<file_id> id(std::size_t index) const noexcept {
+				return ids.empty() ? std::nullopt : ids[index];
+			}
+
+			// \return the entry indexes, sorted by name.
+			std::vector<std::size_t> order() const {
+				std::vector<std::size_t> indexes(name_ends.size());
+				std::iota(indexes.begin(), indexes.end(), std::size_t(0));
+				std::sort(indexes.begin(), indexes.end(), [this](std::size_t a, std::size_t b) {
+					return name(a) < name(b);
+				});
+				return indexes;
+			}
+		};
+
+		// `fs::exists(path)` plus `fs::is_directory(path)` in a single system call.
+		bool probe_path(const fs::path &path, bool &is_dir) {
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+			struct stat st;
+			if (::stat(path.c_str(), &st) != 0)
+				return false;
+			is_dir = S_ISDIR(st.st_mode);
+			return true;
+#else
+			std::error_code ec;
+			auto status = fs::status(path, ec);
+			if (!fs::exists(status))
+				return false;
+			is_dir = fs::is_directory(status);
+			return true;
+#endif
+		}
+
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+		bool stat_at(int dirfd, const char *name, bool &is_dir) {
+			struct stat st;
+			if (::fstatat(dirfd, name, &st, 0) != 0)
+				return false;
+			is_dir = S_ISDIR(st.st_mode);
+			return true;
+		}
+#endif
+
+		static constexpr std::size_t DIRFD_CACHE_SIZE = 64;
+
+		// A bounded, least-recently-used, set of open directory file descriptors, keyed by the directory path as it was queued.
+		//
+		// The native reader lists a directory and looks up its entries relative to an open parent descriptor (`openat()`, `fstatat()`),
+		// so the kernel doesn't have to walk the whole path from the root again for every call.
+		class dirfd_cache {
+		public:
+			explicit dirfd_cache(std::size_t capacity = DIRFD_CACHE_SIZE)
+				: capacity(capacity)
+			{}
+
+			~dirfd_cache() {
+				clear();
+			}
+
+			dirfd_cache(const dirfd_cache &) = delete;
+			dirfd_cache &operator=(const dirfd_cache &) = delete;
+
+			// \return the open descriptor for `dir` (marking it as most recently used) or -1 when it is not cached.
+			int find(const fs::path &dir) {
+				auto it = index.find(dir.native());
+				if (it == index.end())
+					return -1;
+				lru.splice(lru.begin(), lru, it->second);
+				return it->second->second;
+			}
+
+			bool contains(const fs::path &dir) const {
+				return index.contains(dir.native());
+			}
+
+			// take ownership of `fd`, the open descriptor for `dir`; the least recently used descriptor is closed when the cache is full.
+			void insert(const fs::path &dir, int fd) {
+				if (lru.size() >= capacity) {
+					auto &victim = lru.back();
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+					::close(victim.second);
+#endif
+					index.erase(victim.first);
+					lru.pop_back();
+				}
+				lru.emplace_front(dir.native(), fd);
+				index[dir.native()] = lru.begin();
+			}
+
+			void clear() {
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+				for (auto &e : lru) {
+					::close(e.second);
+				}
+#endif
+				lru.clear();
+				index.clear();
+			}
+
+		private:
+			using lru_list = std::list<std::pair<fs::path::string_type, int>>;
+
+			std::size_t capacity;
+			lru_list lru;
+			std::unordered_map<fs::path::string_type, lru_list::iterator> index;
+		};
+
+		// Directory listings shared by the `glob()` runs for a set of pathnames, e.g. `rglob({"src/**/*.cpp", "src/**/*.h"})`,
+		// so that every directory is only listed once. Listings are dropped as soon as none of the pathnames still to run can
+		// ask for them: see `evict_listings()`.
+		struct listing_entry {
+			fs::path path;
+			bool is_dir;
+		};
+		using listing_cache = std::unordered_map<fs::path::string_type, std::vector<listing_entry>>;
+
+		const std::vector<listing_entry> &list_directory(const fs::path &dirname, std::vector<listing_entry> &listing) {
+			auto current_directory = dirname;
+			if (current_directory.empty()) {
+				current_directory = fs::current_path();
+			}
+
+			if (fs::exists(current_directory)) {
+				try {
+					static thread_local std::vector<char> buffer;
+					directory_reader reader(current_directory, GLOB_NATIVE_DIRECTORY_READER_DEFAULT, buffer);
+					while (reader.next()) {
+						const fs::directory_entry *entry = reader.entry();
+						fs::path path = (entry ? entry->path() : current_directory / reader.name());
+						if (dirname.is_absolute()) {
+							listing.push_back({std::move(path), reader.is_directory()});
+						} 
+						else {
+							listing.push_back({fs::relative(path), reader.is_directory()});
+						}
+					}
+				}
+				catch (std::exception&) {
+					// not a directory
+					// do nothing
+				}
+			}
+
+			return listing;
+		}
+
+		std::vector<fs::path> iter_directory(const fs::path &dirname, bool dironly, listing_cache *cache) {
+			std::vector<fs::path> result;
+
+			std::vector<listing_entry> local_listing;
+			const std::vector<listing_entry> *listing;
+			if (cache) {
+				auto it = cache->find(dirname.native());
+				if (it == cache->end()) {
+					it = cache->emplace(dirname.native(), std::vector<listing_entry>{}).first;
+					list_directory(dirname, it->second);
+				}
+				listing = &it->second;
+			}
+			else {
+				listing = &list_directory(dirname, local_listing);
+			}
+
+			for (const auto &entry : *listing) {
+				if (!dironly || entry.is_dir) {
+					result.push_back(entry.path);
+				}
+			}
+
+			return result;
+		}
+
+		// Recursively yields relative pathnames inside a literal directory.
+		std::vector<fs::path> rlistdir(const fs::path &dirname, bool dironly, listing_cache *cache) {
+			std::vector<fs::path> result;
+			//std::cout << "rlistdir: " << dirname.string() << "\n";
+			auto names = iter_directory(dirname, dironly, cache);
+			for (auto &&name : names) {
+				if (!is_hidden(name)) {
+					result.push_back(name);
+					auto matched_dirs = rlistdir(name, dironly, cache);
+					std::copy(std::make_move_iterator(matched_dirs.begin()), std::make_move_iterator(matched_dirs.end()), std::back_inserter(result));
+				}
+			}
+			return result;
+		}
+
+		// This helper function recursively yields relative pathnames inside a literal
+		// directory.
+		std::vector<fs::path> glob2(const fs::path &dirname, [[maybe_unused]] const fs::path &pattern,
+																bool dironly, match_flags /*flags*/, listing_cache *cache) {
+			// std::cout << "In glob2\n";
+			assert(is_recursive(pattern));
+			// '**' matches the directory itself, but only when it exists.
+			if (!dirname.empty() && !fs::is_directory(dirname)) {
+				return {};
+			}
+			std::vector<fs::path> result{"."};
+			auto matched_dirs = rlistdir(dirname, dironly, cache);
+			std::copy(std::make_move_iterator(matched_dirs.begin()), std::make_move_iterator(matched_dirs.end()), std::back_inserter(result));
+			return result;
+		}
+
+		// These 2 helper functions non-recursively glob inside a literal directory.
+		// They return a list of basenames.  _glob1 accepts a pattern while _glob0
+		// takes a literal basename (so it only has to check for its existence).
+
+		std::vector<fs::path> glob1(const fs::path &dirname, const fs::path &pattern,
+																bool dironly, match_flags flags, listing_cache *cache) {
+			// std::cout << "In glob1\n";
+			// a literal pattern only gets here in `case_insensitive` mode: like a direct lookup, it may name a hidden entry.
+			const bool literal = !has_magic(pattern) && !(has_flag(flags, match_flags::extglob) && has_extglob(pattern));
+			std::vector<fs::path> filtered_names;
+			auto names = iter_directory(dirname, dironly, cache);
+			for (auto &&name : names) {
+				if (literal || !is_hidden(name)) {
+					filtered_names.push_back(name.filename());
+					// if (name.is_relative()) {
+					//   // std::cout << "Filtered (Relative): " << name << "\n";
+					//   filtered_names.push_back(fs::relative(name));
+					// } else {
+					//   // std::cout << "Filtered (Absolute): " << name << "\n";
+					//   filtered_names.push_back(name.filename());
+					// }
+				}
+			}
+			return filter(filtered_names, pattern.string(), flags);
+		}
+
+		std::vector<fs::path> glob0(const fs::path &dirname, const fs::path &basename,
+																bool /*dironly*/, match_flags /*flags*/, listing_cache * /*cache*/) {
+			// std::cout << "In glob0\n";
+
+			// 'q*x/' should match only directories.
+			if ((basename.empty() && fs::is_directory(dirname)) || (!basename.empty() && fs::exists(dirname / basename))) {
+				return {basename};
+			}
+			return {};
+		}
+
+		std::vector<fs::path> glob(const fs::path &pathspec, bool recursive, bool dironly,
+															 match_flags flags, listing_cache *cache = nullptr) {
+			std::vector<fs::path> result;
+
+			auto expansions = expand_spec_braces(pathspec, flags);
+			if (expansions.size() > 1) {
+				for (const auto &expansion : expansions) {
+					auto matched = glob(expansion, recursive, dironly, flags, cache);
+					std::copy(std::make_move_iterator(matched.begin()), std::make_move_iterator(matched.end()), std::back_inserter(result));
+				}
+				return result;
+			}
+
+			fs::path path = pathspec;
+
+			path = expand_tilde(path);
+
+			auto dirname = path.parent_path();
+			const auto basename = path.filename().string();
+			auto pathname = path.string();
+
+			if (!needs_matching(path, flags)) {
+				assert(!dironly);
+
+				// Patterns ending with a slash should match only directories
+				if ((!basename.empty() && fs::exists(path)) || (basename.empty() && fs::is_directory(dirname))) {
+					result.push_back(path);
+				}
+				return result;
+			}
+
+			if (dirname.empty()) {
+				if (recursive && is_recursive(basename)) {
+					return glob2(dirname, basename, dironly, flags, cache);
+				}
+				return glob1(dirname, basename, dironly, flags, cache);
+			}
+
+			std::vector<fs::path> dirs{dirname};
+			if (dirname != fs::path(pathname) && needs_matching(dirname, flags)) {
+				dirs = glob(dirname, recursive, true, flags, cache);
+			}
+
+			auto glob_in_dir = glob0;
+			if (needs_matching(basename, flags)) {
+				if (recursive && is_recursive(basename)) {
+					glob_in_dir = glob2;
+				} 
+				else {
+					glob_in_dir = glob1;
+				}
+			}
+
+			for (auto &d : dirs) {
+				for (auto &&name : glob_in_dir(d, basename, dironly, flags, cache)) {
+					fs::path subresult = name;
+					if (name.parent_path().empty()) {
+						subresult = d / name;
+					}
+					result.push_back(subresult.lexically_normal());
+				}
+			}
+
+			return result;
+		}
+
+		std::vector<fs::path> glob(const std::string& pathname, bool recursive, bool dironly,
+			match_flags flags, listing_cache *cache = nullptr) {
+			return glob(fs::path(pathname), recursive, dironly, flags, cache);
+		}
+
+		// `dir` without a trailing separator, e.g. "src" for "src/./".
+		fs::path normalized_directory(const fs::path &dir) {
+			fs::path normal = dir.lexically_normal();
+			if (!normal.empty() && !normal.has_filename() && normal.has_relative_path()) {
+				normal = normal.parent_path();
+			}
+			return normal;
+		}
+
+		// \return true when `root` is `dir` or one of its parent directories. The current directory covers all relative paths.
+		bool is_within(const fs::path &root, const fs::path &dir) {
+			if (root.empty() || root == ".")
+				return dir.is_relative();
+			auto d = dir.begin();
+			for (const auto &element : root) {
+				if (d == dir.end() || *d != element)
+					return false;
+				++d;
+			}
+			return true;
+		}
+
+		// The literal leading directories of `pathspec`, one per brace expansion: the directories its `glob()` run lists are all
+		// at or below these. (Listings reached through symlinks may lie elsewhere; evicting those early only costs a second listing.)
+		std::vector<fs::path> listing_roots(const fs::path &pathspec, match_flags flags) {
+			std::vector<fs::path> roots;
+			for (const auto &expansion : expand_spec_braces(pathspec, flags)) {
+				fs::path root;
+				for (const auto &element : expand_tilde(expansion).parent_path()) {
+					if (needs_matching(element, flags))
+						break;
+					root /= element;
+				}
+				roots.push_back(normalized_directory(root));
+			}
+			return roots;
+		}
+
+		// Drops the listings which are not within any of the `roots` of the pathnames still to run.
+		void evict_listings(listing_cache &cache, const std::vector<fs::path> &roots) {
+			for (auto it = cache.begin(); it != cache.end();) {
+				const fs::path dir = normalized_directory(it->first);
+				const bool wanted = std::any_of(roots.begin(), roots.end(), [&dir](const fs::path &root) {
+					return is_within(root, dir);
+				});
+				it = (wanted ? std::next(it) : cache.erase(it));
+			}
+		}
+
+		// A search spec (one of the `options::pathnames`) is parsed once into a sequence of segments; the scan then
+		// walks this 'program' instead of re-deriving path fragments for every directory it visits.
+		struct spec_segment {
+			enum kind_t {
+				literal,				// one or more consecutive non-wildcarded path elements, e.g. "src/core" in "src/core/*.cpp"
+				wildcard,				// a wildcarded path element, e.g. "*.cpp"
+				double_star,		// "**": matches zero or more directory levels
+				alternatives,		// brace alternatives which continue differently, e.g. "{core,net/*}" in "src/{core,net/*}/*.cpp": see `branches`
+			};
+
+			kind_t kind;
+
+			fs::path text;			// the path element(s) represented by this segment; reported as `filter_info_t::matching_wildcarded_fragment`
+			fs::path rest;			// the remainder of the search spec following this segment; reported as `filter_info_t::subsearch_spec`
+
+			const wildcard_matcher *matcher;		// the shared compiled matcher for `wildcard` segments
+
+			bool is_last;										// no further segments follow, i.e. `rest` is empty
+			bool accepts_directories_only;	// when the search spec ended in a '/', that signaled the user only wishes to receive directory entries.
+
+			int next;				// the segment to continue with once this one has been matched
+			int recurse;		// `double_star` only: the segment to continue with in each subdirectory
+
+			std::vector<int> branches;		// `alternatives` only: the segments to continue with, all in the same directory
+		};
+
+		struct spec_program {
+			std::vector<spec_segment> segments;
+			int override_segment;		// the (implicit) "*" segment used when userland filter() overrides force a scan of a directory which is not part of the original spec.
+
+			fs::path basepath;
+			int max_recursion_depth;
+			int original_spec_index;
+		};
+
+		// one spec program being matched against a directory.
+		struct scan_state {
+			int program;					// index into `cached_options::programs`
+			int segment;					// the segment of that program to process in the directory
+			int actual_depth;
+		};
+
+		// The spec states for one directory. Unless `options::merge_overlapping_specs` is set that's a single state, which is stored
+		// inline: queueing a directory then doesn't allocate.
+		class scan_state_list {
+		public:
+			scan_state_list() = default;
+			scan_state_list(const scan_state &state) : first(state), count(1) {}
+
+			std::size_t size() const {
+				return count;
+			}
+
+			bool empty() const {
+				return count == 0;
+			}
+
+			const scan_state &operator[](std::size_t index) const {
+				return index == 0 ? first : more[index - 1];
+			}
+
+			void push_back(const scan_state &state) {
+				if (count == 0)
+					first = state;
+				else
+					more.push_back(state);
+				count++;
+			}
+
+			void append(const scan_state_list &other) {
+				for (std::size_t index = 0; index < other.size(); index++) {
+					push_back(other[index]);
+				}
+			}
+
+		private:
+			scan_state first{};
+			std::size_t count = 0;
+			std::vector<scan_state> more;
+		};
+
+		// a directory to be scanned, as it is passed to `queue_searchspec()`; see `queued_searchspec` for the compact form it's queued in.
+		struct searchspec {
+			fs::path basepath;		// the non-wildcarded base
+
+			// the spec programs to match in `basepath`. Unless `options::merge_overlapping_specs` is set, this is always
+			// a single state; otherwise every state which will visit `basepath` is collected here, so the directory is only listed once.
+			scan_state_list states;
+
+			bool basepath_exists;							// flag/cache to help reduce the number of system calls during a scan: when `true`, we already know `fs::exists(basepath)` is true.
+		};
+
+		// The directories of the queued searchspecs, stored as a tree: every node is the text a directory appends to the path of its parent,
+		// e.g. "/core" below "src". That text is interned, so the many directories named "include", "src", etc. share their name.
+		// Nodes are referenced by the searchspecs queued for them and by their child nodes; a node which is no longer referenced is recycled,
+		// so the table grows with the number of directories waiting to be scanned, not with the number of directories visited.
+		class directory_table {
+		public:
+			using string_type = fs::path::string_type;
+			using string_view_type = std::basic_string_view<fs::path::value_type>;
+
+			directory_table() = default;
+			directory_table(directory_table &&) = default;
+			directory_table &operator=(directory_table &&) = default;
+
+			// a copy has its own `names`: its index must refer to those, rather than to the names of `other`.
+			directory_table(const directory_table &other)
+				: nodes(other.nodes),
+				free_nodes(other.free_nodes),
+				names(other.names),
+				name_refs(other.name_refs),
+				free_names(other.free_names),
+				children(other.children)
+			{
+				reindex();
+			}
+
+			directory_table &operator=(const directory_table &other) {
+				if (this != &other) {
+					nodes = other.nodes;
+					free_nodes = other.free_nodes;
+					names = other.names;
+					name_refs = other.name_refs;
+					free_names = other.free_names;
+					children = other.children;
+					reindex();
+				}
+				return *this;
+			}
+
+			// \return the node for `parent` (-1 for none, i.e. a base path of the search specs) extended with `name`. The node starts out with a single reference.
+			// A `shared` node is returned again, with another reference, by every `add()` for the same `parent` and `name` while it is alive.
+			int add(int parent, string_view_type name, bool shared = false) {
+				const int name_id = intern(name);
+				if (shared) {
+					auto it = children.find(child_key(parent, name_id));
+					if (it != children.end()) {
+						name_refs[name_id]--;
+						nodes[it->second].refs++;
+						return it->second;
+					}
+				}
+				if (parent >= 0)
+					nodes[parent].refs++;
+
+				const node added{parent, name_id, 1};
+				int id;
+				if (free_nodes.empty()) {
+					id = (int)nodes.size();
+					nodes.push_back(added);
+				}
+				else {
+					id = free_nodes.back();
+					free_nodes.pop_back();
+					nodes[id] = added;
+				}
+				if (shared)
+					children.emplace(child_key(parent, name_id), id);
+				return id;
+			}
+
+			void release(int id) {
+				while (id >= 0 && --nodes[id].refs == 0) {
+					const node &gone = nodes[id];
+					if (!children.empty()) {
+						auto it = children.find(child_key(gone.parent, gone.name));
+						if (it != children.end() && it->second == id)
+							children.erase(it);
+					}
+					if (--name_refs[gone.name] == 0) {
+						name_index.erase(string_view_type(names[gone.name]));
+						free_names.push_back(gone.name);
+					}
+					free_nodes.push_back(id);
+					id = gone.parent;
+				}
+			}
+
+			fs::path path(int id) const {
+				std::size_t length = 0;
+				for (int at = id; at >= 0; at = nodes[at].parent) {
+					length += names[nodes[at].name].size();
+				}
+				string_type text(length, 0);
+				for (int at = id; at >= 0; at = nodes[at].parent) {
+					const string_type &name = names[nodes[at].name];
+					length -= name.size();
+					text.replace(length, name.size(), name);
+				}
+				return fs::path(std::move(text));
+			}
+
+		private:
+			struct node {
+				int parent;
+				int name;				// index into `names`
+				int refs;
+			};
+
+			static uint64_t child_key(int parent, int name) {
+				return (uint64_t(uint32_t(parent + 1)) << 32) | uint32_t(name);
+			}
+
+			int intern(string_view_type name) {
+				auto it = name_index.find(name);
+				if (it != name_index.end()) {
+					name_refs[it->second]++;
+					return it->second;
+				}
+				int id;
+				if (free_names.empty()) {
+					id = (int)names.size();
+					names.emplace_back(name);
+					name_refs.push_back(1);
+				}
+				else {
+					id = free_names.back();
+					free_names.pop_back();
+					names[id] = name;
+					name_refs[id] = 1;
+				}
+				// `names` is a deque: its strings never move, so the keys remain valid.
+				name_index.emplace(string_view_type(names[id]), id);
+				return id;
+			}
+
+			void reindex() {
+				name_index.clear();
+				for (std::size_t id = 0; id < names.size(); id++) {
+					if (name_refs[id] > 0)
+						name_index.emplace(string_view_type(names[id]), (int)id);
+				}
+			}
+
+			std::vector<node> nodes;
+			std::vector<int> free_nodes;
+
+			std::deque<string_type> names;
+			std::vector<int> name_refs;
+			std::vector<int> free_names;
+			std::unordered_map<string_view_type, int> name_index;
+			std::unordered_map<uint64_t, int> children;		// the `shared` nodes, by parent and name
+		};
+
+		// a searchspec as it is kept in the queue: its basepath is a node of the `directory_table`.
+		struct queued_searchspec {
+			int directory;
+			bool basepath_exists;
+			scan_state_list states;
+		};
+
+		// `options::deduplicate`: the results reported so far. Pathnames are stored only once, in an arena, and looked up through an
+		// open addressing table of their (1-based) arena indexes; files are identified by their device and inode number.
+		class reported_results {
+		public:
+			using string_view_type = path_arena::string_view_type;
+
+			// \return `false` when `pathname` has been reported before.
+			bool insert(string_view_type pathname) {
+				if ((names.size() + 1) * 2 > slots.size())
+					grow();
+				for (std::size_t at = std::hash<string_view_type>{}(pathname) & (slots.size() - 1);; at = (at + 1) & (slots.size() - 1)) {
+					if (slots[at] == 0) {
+						names.push_back(pathname);
+						slots[at] = (std::uint32_t)names.size();
+						return true;
+					}
+					if (names[slots[at] - 1] == pathname)
+						return false;
+				}
+			}
+
+			// \return `false` when the file `id` has been reported before.
+			bool insert(const file_id &id) {
+				return files.insert(id).second;
+			}
+
+		private:
+			void grow() {
+				std::vector<std::uint32_t> rehashed(std::max<std::size_t>(64, slots.size() * 2), 0);
+				for (std::size_t index = 0; index < names.size(); index++) {
+					std::size_t at = std::hash<string_view_type>{}(names[index]) & (rehashed.size() - 1);
+					while (rehashed[at] != 0)
+						at = (at + 1) & (rehashed.size() - 1);
+					rehashed[at] = (std::uint32_t)(index + 1);
+				}
+				slots = std::move(rehashed);
+			}
+
+			struct file_id_hash {
+				std::size_t operator()(const file_id &id) const noexcept {
+					return std::hash<std::uint64_t>{}(id.inode * 0x9E3779B97F4A7C15ull ^ id.device);
+				}
+			};
+
+			path_arena names;
+			std::vector<std::uint32_t> slots;
+			std::unordered_set<file_id, file_id_hash> files;
+		};
+
+		// `dedup_mode::path`: whether `lexically_normal()` would leave `text` as it is, i.e. it has no "." or ".." elements and no repeated
+		// (or, on Windows, non-preferred) separators. Most results are, so they don't need a normalized copy.
+		bool is_lexically_normal(path_arena::string_view_type text) noexcept {
+			using char_type = path_arena::string_view_type::value_type;
+			std::size_t element = 0;
+			for (std::size_t at = 0; at <= text.size(); at++) {
+				if (at < text.size() && !is_separator(text[at]))
+					continue;
+				if (at < text.size() && text[at] != char_type(fs::path::preferred_separator))
+					return false;
+				const auto name = text.substr(element, at - element);
+				if ((name.size() == 1 || name.size() == 2) && name.find_first_not_of(char_type('.')) == name.npos)
+					return false;
+				if (name.empty() && at > 0 && at < text.size())
+					return false;
+				element = at + 1;
+			}
+			return true;
+		}
+
+		// `dedup_mode::file`: \return the device and inode number of the file `path` refers to, or nothing when it can't be determined.
+		std::optional<file_id> identify_file(const fs::path &path) {
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+			struct stat st;
+			if (::stat(path.c_str(), &st) == 0)
+				return file_id{(std::uint64_t)st.st_dev, (std::uint64_t)st.st_ino};
+#endif
+			return std::nullopt;
+		}
+
+		struct shared_run;
+
+		struct cached_options {
+			fs::path basepath;
+			std::vector<spec_program> programs;
+			// the searchspecs queued and not yet scanned: breadth first scans take them from the front, depth first scans from the back.
+			// `searchpath_index` counts the searchspecs taken so far, `searchpath_count` those queued so far.
+			std::deque<queued_searchspec> searchpaths;
+			directory_table directories;			// their basepaths; multi-threaded runs share the table of `shared_run` instead.
+			int searchpath_index = -1;
+			int searchpath_count = 0;
+			int searchpaths_popped = 0;				// taken from the front of `searchpaths`: the queue position of `searchpaths[0]`
+			std::size_t searchpaths_unordered = 0;		// `traversal_order::depth_first`: the searchspecs from here on have been queued since the last one was taken
+			traversal_order traversal = traversal_order::breadth_first;		// the order the current searchspec was taken in
+
+			// the directory being scanned: the directories queued while scanning it are stored relative to it.
+			int scanning = -1;
+			fs::path::string_type scanning_path;
+
+			// every distinct wildcard spec element is compiled only once per glob() run; the spec segments point into this set.
+			// (std::unordered_map guarantees pointer stability for its elements.)
+			std::unordered_map<std::string, wildcard_matcher> matchers;
+			match_flags matching = match_flags::none;		// `options::case_insensitive` and `options::extglob`: compile the matchers accordingly
+
+			// `options::merge_overlapping_specs` mode: the queued, not yet processed, searchpaths by their (shared) `directories` node, with their queue position.
+			bool merge_specs = false;
+			std::unordered_map<int, int> pending;
+
+			// `options::use_native_directory_reader` and the getdents64 buffer, which is reused for every directory.
+			bool native_reader = false;
+			std::vector<char> dirent_buffer;
+			dirfd_cache dirfds;
+
+			// the options are a plain `glob::options`, so `filter()` passes everything on as is and `progress_reporting()` never objects:
+			// the callbacks are skipped.
+			bool default_callbacks = false;
+			bool copy_info_paths = false;		// `options::copy_filter_info_paths`
+
+			// `options::use_io_uring`: created on first use, per worker thread.
+			bool use_io_uring = false;
+			std::unique_ptr<statx_batch> statx_ring;
+			std::unique_ptr<open_prefetch> prefetch;		// single-threaded runs only
+
+			// multi-threaded runs (see `options::thread_count`): the state shared by all workers. Each worker has its own `cached_options`,
+			// where `searchpaths` only collects the searchspecs queued while scanning the current directory.
+			shared_run *shared = nullptr;
+
+			int item_count_scanned = 0;
+			int dir_count_scanned = 0;
+
+			bool report_100pct_done_pending = true;
+
+			// `options::deduplicate`: multi-threaded runs share the results reported by `shared_run` instead.
+			dedup_mode dedup = dedup_mode::none;
+			reported_results reported;
+
+			std::vector<fs::path> result_set;
+			path_arena *arena = nullptr;			// `glob(options&, path_arena&)`: the accepted paths go here instead of `result_set`
+			path_tree *tree = nullptr;				// `glob(options&, path_tree&)`: ditto
+			std::vector<std::string> error_msg;
+		};
+
+		// `options::ordering`: the results are sorted by their complete pathname once they have all been found.
+		bool sorts_results(result_order order) noexcept {
+			return order == result_order::bytes || order == result_order::natural;
+		}
+
+		template <typename Char>
+		constexpr bool is_digit(Char c) noexcept {
+			return c >= Char('0') && c <= Char('9');
+		}
+
+		// `result_order::natural`: runs of digits compare by their numeric value, everything else compares bytewise.
+		// Pathnames which only differ in the leading zeros of their numbers are ordered bytewise.
+		template <typename Char>
+		bool natural_less(std::basic_string_view<Char> a, std::basic_string_view<Char> b) noexcept {
+			using traits = std::char_traits<Char>;
+			std::size_t i = 0;
+			std::size_t j = 0;
+			while (i < a.size() && j < b.size()) {
+				if (is_digit(a[i]) && is_digit(b[j])) {
+					// without their leading zeros, the longer run of digits is the larger number; runs of equal length compare as text.
+					while (i < a.size() && a[i] == Char('0'))
+						i++;
+					while (j < b.size() && b[j] == Char('0'))
+						j++;
+					std::size_t a_end = i;
+					while (a_end < a.size() && is_digit(a[a_end]))
+						a_end++;
+					std::size_t b_end = j;
+					while (b_end < b.size() && is_digit(b[b_end]))
+						b_end++;
+					if (a_end - i != b_end - j)
+						return a_end - i < b_end - j;
+					const int order = traits::compare(a.data() + i, b.data() + j, a_end - i);
+					if (order != 0)
+						return order < 0;
+					i = a_end;
+					j = b_end;
+					continue;
+				}
+				if (a[i] != b[j])
+					return traits::lt(a[i], b[j]);
+				i++;
+				j++;
+			}
+			if (i < a.size() || j < b.size())
+				return j < b.size();
+			return a < b;
+		}
+
+		struct pathname_less {
+			bool natural;
+
+			bool operator()(path_arena::string_view_type a, path_arena::string_view_type b) const noexcept {
+				return natural ? natural_less(a, b) : a < b;
+			}
+			bool operator()(const fs::path &a, const fs::path &b) const noexcept {
+				return (*this)(path_arena::string_view_type(a.native()), path_arena::string_view_type(b.native()));
+			}
+		};
+
+		// Sort the results collected in `cache` by `options::ordering`. Multi-threaded runs do this per worker, and merge the sorted runs of
+		// all workers afterwards.
+		void sort_results(cached_options &cache, result_order order) {
+			if (!sorts_results(order))
+				return;
+			const pathname_less less{order == result_order::natural};
+			if (cache.arena) {
+				std::vector<path_arena::string_view_type> paths(cache.arena->begin(), cache.arena->end());
+				std::sort(paths.begin(), paths.end(), less);
+				path_arena sorted;
+				sorted.reserve(paths.size(), cache.arena->characters());
+				for (auto path : paths) {
+					sorted.push_back(path);
+				}
+				*cache.arena = std::move(sorted);
+			}
+			else {
+				std::sort(cache.result_set.begin(), cache.result_set.end(), less);
+			}
+		}
+
+		// Merge the consecutive sorted runs of `items`, which end at the offsets `ends`, pairwise until they form a single sorted run.
+		// Every pass splits its merges into about `thread_count` pieces, which are merged into a second buffer concurrently: the longer
+		// run of a pair is cut at equal intervals and the shorter one where those elements would go, so no piece depends on another.
+		template <typename T>
+		void merge_sorted_runs(std::vector<T> &items, std::vector<std::size_t> ends, const pathname_less &less, int thread_count) {
+			// smaller pieces aren't worth a thread.
+			constexpr std::size_t min_piece_size = 4096;
+
+			struct piece {
+				std::size_t a, a_end;		// from the first run of the pair
+				std::size_t b, b_end;		// from the second one
+				std::size_t out;
+			};
+
+			std::vector<T> merged(items.size());
+			while (ends.size() > 1) {
+				std::vector<piece> pieces;
+				std::vector<std::size_t> next_ends;
+				const std::size_t pairs = ends.size() / 2;
+				const std::size_t parts = std::max<std::size_t>(1, thread_count / pairs);
+
+				for (std::size_t index = 0; index < ends.size(); index += 2) {
+					const std::size_t begin = (index ? ends[index - 1] : 0);
+					const std::size_t middle = ends[index];
+					// a run without a partner is merely moved.
+					const std::size_t end = (index + 1 < ends.size() ? ends[index + 1] : middle);
+					const std::size_t count = std::clamp<std::size_t>((end - begin) / min_piece_size, 1, parts);
+
+					std::size_t a = begin;
+					std::size_t b = middle;
+					for (std::size_t part = 1; part <= count; part++) {
+						std::size_t a_end = middle;
+						std::size_t b_end = end;
+						if (part < count) {
+							// the elements of the first run go before equal ones of the second run.
+							if (middle - begin >= end - middle) {
+								a_end = std::max(a, begin + (middle - begin) * part / count);
+								b_end = std::lower_bound(items.begin() + b, items.begin() + end, items[a_end], less) - items.begin();
+							}
+							else {
+								b_end = std::max(b, middle + (end - middle) * part / count);
+								a_end = std::upper_bound(items.begin() + a, items.begin() + middle, items[b_end], less) - items.begin();
+							}
+						}
+						pieces.push_back(piece{a, a_end, b, b_end, a + b - middle});
+						a = a_end;
+						b = b_end;
+					}
+					next_ends.push_back(end);
+				}
+
+				auto merge_piece = [&items, &merged, &less](const piece &p) {
+					std::merge(std::make_move_iterator(items.begin() + p.a), std::make_move_iterator(items.begin() + p.a_end),
+										 std::make_move_iterator(items.begin() + p.b), std::make_move_iterator(items.begin() + p.b_end),
+										 merged.begin() + p.out, less);
+				};
+				std::vector<std::thread> pool;
+				for (std::size_t index = 1; index < pieces.size(); index++) {
+					pool.emplace_back(merge_piece, std::cref(pieces[index]));
+				}
+				merge_piece(pieces.front());
+				for (auto &thread : pool) {
+					thread.join();
+				}
+
+				items.swap(merged);
+				ends = std::move(next_ends);
+			}
+		}
+
+		// A worker's queue of searchspecs: the owner takes the most recently queued item, while idle workers steal the oldest one.
+		struct work_deque {
+			std::mutex lock;
+			std::deque<queued_searchspec> items;
+		};
+
+		struct shared_run {
+			explicit shared_run(int thread_count)
+				: deques(thread_count)
+			{}
+
+			std::vector<work_deque> deques;
+
+			std::atomic<int> queued{0};					// searchspecs waiting in the deques
+			std::atomic<int> outstanding{0};		// searchspecs queued or being scanned: the run is done when this drops to zero
+			std::atomic<int> started{0};				// searchspecs taken so far, for `filter_info_t::actual_search_spec_index`
+			std::atomic<int> total{0};					// searchspecs queued so far, for `filter_info_t::search_spec_count`
+
+			std::atomic<int> item_count_scanned{0};
+			std::atomic<int> dir_count_scanned{0};
+
+			std::atomic<bool> aborted{false};
+
+			std::atomic<int> idle{0};
+			std::mutex idle_lock;
+			std::condition_variable idle_cv;
+
+			std::mutex error_lock;
+			std::exception_ptr error;
+
+			std::mutex directories_lock;
+			directory_table directories;
+
+			std::mutex reported_lock;
+			reported_results reported;
+		};
+
+		// the `directory_table` of the basepaths queued in `cache`, along with the lock guarding it in multi-threaded runs.
+		std::pair<directory_table &, std::unique_lock<std::mutex>> lock_directories(cached_options &cache) {
+			if (cache.shared)
+				return {cache.shared->directories, std::unique_lock<std::mutex>(cache.shared->directories_lock)};
+			return {cache.directories, std::unique_lock<std::mutex>()};
+		}
+
+		// the results reported so far in `cache`, along with the lock guarding them in multi-threaded runs.
+		std::pair<reported_results &, std::unique_lock<std::mutex>> lock_reported(cached_options &cache) {
+			if (cache.shared)
+				return {cache.shared->reported, std::unique_lock<std::mutex>(cache.shared->reported_lock)};
+			return {cache.reported, std::unique_lock<std::mutex>()};
+		}
+
+		// `options::deduplicate`: \return `false` when `path` duplicates a result reported before. The key is computed before taking the lock.
+		// `known` is the id of the file when the scan already learned it.
+		bool first_report(cached_options &cache, const fs::path &path, std::optional<file_id> known) {
+			if (cache.dedup == dedup_mode::file) {
+				if (!known)
+					known = identify_file(path);
+				if (known) {
+					auto [reported, guard] = lock_reported(cache);
+					return reported.insert(*known);
+				}
+			}
+			if (!is_lexically_normal(path.native())) {
+				const fs::path normal = path.lexically_normal();
+				auto [reported, guard] = lock_reported(cache);
+				return reported.insert(reported_results::string_view_type(normal.native()));
+			}
+			auto [reported, guard] = lock_reported(cache);
+			return reported.insert(reported_results::string_view_type(path.native()));
+		}
+
+		void add_result(cached_options &cache, const fs::path &path, std::optional<file_id> known = std::nullopt) {
+			if (cache.dedup != dedup_mode::none && !first_report(cache, path, known))
+				return;
+			if (cache.arena)
+				cache.arena->push_back(path.native());
+			else if (cache.tree)
+				cache.tree->push_back(path);
+			else
+				cache.result_set.push_back(path);
+		}
+
+		int search_spec_count(const cached_options &cache) {
+			if (cache.shared)
+				return cache.shared->total.load(std::memory_order_relaxed);
+			return cache.searchpath_count;
+		}
+
+		// With `options::copy_filter_info_paths`, the callbacks get copies of the paths in the path fields of `info` as well.
+		void fill_info_paths(const cached_options &cache, options::filter_info_t &info) {
+			if (!cache.copy_info_paths)
+				return;
+			info.basepath = info.get_basepath();
+			info.item_relpath = info.get_item_relpath();
+			if (info.entry_ref)
+				info.entry = *info.entry_ref;
+			info.matching_wildcarded_fragment = info.get_matching_wildcarded_fragment();
+			info.subsearch_spec = info.get_subsearch_spec();
+		}
+
+		const wildcard_matcher *shared_matcher(cached_options &cache, const std::string &pattern) {
+			auto it = cache.matchers.find(pattern);
+			if (it == cache.matchers.end()) {
+				it = cache.matchers.emplace(pattern, compile_wildcard(pattern, has_flag(cache.matching, match_flags::case_insensitive), has_flag(cache.matching, match_flags::extglob),
+																															has_flag(cache.matching, match_flags::brace_expansion))).first;
+			}
+			return &it->second;
+		}
+
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+		// `probe_path(dir / rel)`, looked up relative to the cached descriptor of `dir` or of its parent directory when available.
+		bool probe_entry(cached_options &cache, const fs::path &dir, const fs::path &rel, bool &is_dir) {
+			int fd = cache.dirfds.find(dir);
+			if (fd >= 0)
+				return stat_at(fd, rel.c_str(), is_dir);
+
+			const fs::path name = dir.filename();
+			if (!name.empty() && name != "." && name != "..") {
+				fd = cache.dirfds.find(dir.parent_path());
+				if (fd >= 0)
+					return stat_at(fd, (name / rel).c_str(), is_dir);
+			}
+			return probe_path(dir / rel, is_dir);
+		}
+
+		// Open `dir` for listing, relative to its parent directory's descriptor when that one is still cached.
+		// The descriptor is owned by `cache.dirfds`, so it can serve the lookups in its subdirectories later on.
+		// \return the descriptor, rewound to the start of the directory, or -1 when permission is denied.
+		int open_directory(cached_options &cache, const fs::path &dir) {
+			std::optional<int> prefetched;
+#if GLOB_HAS_IO_URING
+			if (cache.prefetch)
+				prefetched = cache.prefetch->take(dir);
+#endif
+			int fd = cache.dirfds.find(dir);
+			if (fd >= 0) {
+				if (prefetched && *prefetched >= 0)
+					::close(*prefetched);
+				::lseek(fd, 0, SEEK_SET);
+				return fd;
+			}
+
+			const fs::path name = dir.filename();
+			int parent_fd = -1;
+			if (!name.empty() && name != "." && name != "..") {
+				parent_fd = cache.dirfds.find(dir.parent_path());
+			}
+			if (prefetched) {
+				fd = *prefetched;
+				if (fd < 0) {
+					errno = -fd;
+					fd = -1;
+				}
+			}
+			else if (parent_fd >= 0)
+				fd = ::openat(parent_fd, name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			else
+				fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+			if (fd < 0) {
+				if (errno == EACCES)
+					return -1;
+				throw fs::filesystem_error("cannot open directory", dir, std::error_code(errno, std::generic_category()));
+			}
+			cache.dirfds.insert(dir, fd);
+			return fd;
+		}
+#else
+		bool probe_entry(cached_options &cache, const fs::path &dir, const fs::path &rel, bool &is_dir) {
+			return probe_path(dir / rel, is_dir);
+		}
+#endif
+
+		// The brace expansions of a search spec are collected in a trie of path elements: expansions which start with the same
+		// elements share those nodes, and thus their segments, e.g. "src/{core,net}/*.cpp" only has a single "src" segment.
+		struct spec_trie_node {
+			fs::path text;
+			bool literal;
+			bool terminal = false;			// an expansion ends with this element
+			std::vector<int> children;
+		};
+
+		// Turns the trie into the segments of a spec program.
+		struct spec_builder {
+			cached_options &cache;
+			spec_program &program;
+			const std::vector<spec_trie_node> &trie;
+			bool accepts_directories_only;
+
+			int add(spec_segment seg) {
+				program.segments.push_back(std::move(seg));
+				return (int)program.segments.size() - 1;
+			}
+
+			int add_alternatives() {
+				return add(spec_segment{
+					.kind = spec_segment::alternatives,
+					.matcher = nullptr,
+					.is_last = false,
+					.accepts_directories_only = accepts_directories_only,
+					.next = -1,
+					.recurse = -1,
+				});
+			}
+
+			// a trailing separator produces an empty last element: after a wildcard that one only signals `accepts_directories_only`.
+			bool ends_in_separator(int node) const {
+				const auto &children = trie[node].children;
+				return children.size() == 1 && trie[children[0]].text.empty() && trie[children[0]].children.empty();
+			}
+
+			// the text of the spec following `node`, reported as `filter_info_t::subsearch_spec`.
+			fs::path rest_of(int node) const {
+				const auto &children = trie[node].children;
+				if (children.size() == 1 && !trie[node].terminal)
+					return text_of(children[0]);
+				if (children.empty())
+					return {};
+				std::string text = (trie[node].terminal ? "{," : "{");
+				for (std::size_t i = 0; i < children.size(); i++) {
+					if (i > 0)
+						text += ',';
+					text += text_of(children[i]).string();
+				}
+				return text + "}";
+			}
+
+			fs::path text_of(int node) const {
+				return trie[node].children.empty() ? trie[node].text : trie[node].text / rest_of(node);
+			}
+
+			// \return the segment to continue with after `node`.
+			int emit_children(int node) {
+				const auto &children = trie[node].children;
+				if (children.size() == 1)
+					return emit(children[0]);
+				const int index = add_alternatives();
+				for (int child : children) {
+					const int branch = emit(child);
+					program.segments[index].branches.push_back(branch);
+				}
+				return index;
+			}
+
+			int emit(int node) {
+				// consecutive literal elements are looked up in one go.
+				int last = node;
+				fs::path text = trie[node].text;
+				if (trie[node].literal) {
+					while (!trie[last].terminal && trie[last].children.size() == 1 && trie[trie[last].children[0]].literal) {
+						last = trie[last].children[0];
+						text /= trie[last].text;
+					}
+				}
+
+				if (!trie[node].literal && ends_in_separator(last))
+					return emit_segment(node, last, text, true);
+				if (trie[last].terminal && !trie[last].children.empty()) {
+					// e.g. "{a,a/b}": "a" matches by itself and also continues with "b".
+					const int index = add_alternatives();
+					const int matches = emit_segment(node, last, text, true);
+					const int continues = emit_segment(node, last, text, false);
+					program.segments[index].branches = {matches, continues};
+					return index;
+				}
+				return emit_segment(node, last, text, trie[last].children.empty());
+			}
+
+			int emit_segment(int first, int last, const fs::path &text, bool is_last) {
+				spec_segment seg{
+					.kind = spec_segment::literal,
+					.text = text,
+					.rest = (is_last ? fs::path() : rest_of(last)),
+					.matcher = nullptr,
+					.is_last = is_last,
+					.accepts_directories_only = accepts_directories_only,
+					.next = -1,
+					.recurse = -1,
+				};
+				if (!trie[first].literal) {
+					if (is_recursive(text)) {
+						seg.kind = spec_segment::double_star;
+					}
+					else {
+						seg.kind = spec_segment::wildcard;
+						seg.matcher = shared_matcher(cache, text.string());
+					}
+				}
+				const int index = add(seg);
+
+				if (!is_last) {
+					const int next = emit_children(last);
+					program.segments[index].next = next;
+					if (seg.kind == spec_segment::double_star) {
+						program.segments[index].recurse = index;
+					}
+				}
+				else if (seg.kind == spec_segment::double_star) {
+					// when there's no further (possibly wildcarded) search spec following the '**', then we assume it is '/*' for
+					// every subdirectory, i.e.
+					//    /bla/**
+					// is assumed identical to
+					//    /bla/**/*
+					// while '**' itself still matches the base directory and all its subdirectories.
+					const int implicit_double_star = index + 1;
+					const int implicit_star = index + 2;
+
+					spec_segment ds = seg;
+					ds.rest = "*";
+					ds.is_last = false;
+					ds.next = implicit_star;
+					ds.recurse = implicit_double_star;
+
+					spec_segment star{
+						.kind = spec_segment::wildcard,
+						.text = "*",
+						.rest = "",
+						.matcher = shared_matcher(cache, "*"),
+						.is_last = true,
+						.accepts_directories_only = accepts_directories_only,
+						.next = -1,
+						.recurse = -1,
+					};
+
+					program.segments[index].next = implicit_star;
+					program.segments[index].recurse = implicit_double_star;
+					add(ds);
+					add(star);
+				}
+				return index;
+			}
+		};
+
+		// Parse the brace expansions `specs` of a search spec into one program; the program starts with segment 0.
+		spec_program parse_spec(cached_options &cache, const std::vector<fs::path> &specs, bool accepts_directories_only) {
+			std::vector<spec_trie_node> trie(1);		// [0]: the basepath
+
+			for (const auto &spec : specs) {
+				std::vector<fs::path> elems(spec.begin(), spec.end());
+
+				// the root name and root directory elements are never matched, not even in `case_insensitive` mode.
+				const std::size_t root_elems = (spec.has_root_name() ? 1 : 0) + (spec.has_root_directory() ? 1 : 0);
+
+				int node = 0;
+				for (std::size_t i = 0; i < elems.size(); i++) {
+					const bool literal = (i < root_elems ? !has_magic(elems[i]) : !needs_matching(elems[i], cache.matching));
+					int child = -1;
+					for (int candidate : trie[node].children) {
+						if (trie[candidate].literal == literal && trie[candidate].text.native() == elems[i].native()) {
+							child = candidate;
+							break;
+						}
+					}
+					if (child < 0) {
+						child = (int)trie.size();
+						trie.push_back(spec_trie_node{.text = elems[i], .literal = literal});
+						trie[node].children.push_back(child);
+					}
+					node = child;
+				}
+				trie[node].terminal = true;
+			}
+
+			spec_program program;
+			spec_builder builder{cache, program, trie, accepts_directories_only};
+			builder.emit_children(0);
+
+			spec_segment any{
+				.kind = spec_segment::wildcard,
+				.text = "*",
+				.rest = "",
+				.matcher = shared_matcher(cache, "*"),
+				.is_last = true,
+				.accepts_directories_only = false,   // we drop this requirement here as the userland override has us going out of original scope already.
+				.next = -1,
+				.recurse = -1,
+			};
+			program.override_segment = (int)program.segments.size();
+			program.segments.push_back(any);
+
+			return program;
+		}
+
+		bool report_100_pct_done(cached_options &cache, options &search_spec) {
+			if (cache.report_100pct_done_pending) {
+				cache.report_100pct_done_pending = false;
+
+				// report progress @ 100% done:
+				options::filter_info_t fi{
+					.fragment_is_wildcarded = false,
+					.fragment_is_double_star = false,
+
+					//.userland_may_override_accept = true,
+					.userland_may_override_recurse_into = false,
+
+					.is_directory = false,
+					.is_hidden = false,
+
+					.depth = -1,
+					.max_recursion_depth = -1,
+
+					.item_count_scanned = cache.item_count_scanned,
+					.dir_count_scanned = cache.dir_count_scanned,
+
+					.original_search_spec_index = -1,
+					.actual_search_spec_index = search_spec_count(cache),
+					.search_spec_count = search_spec_count(cache),
+
+					.traversal = cache.traversal,
+
+					.basepath_ref = &cache.basepath,
+					.item_relpath_ref = nullptr,
+					.item_name = {},
+					.entry_ref = nullptr,
+
+					.matching_wildcarded_fragment_ref = nullptr,
+					.subsearch_spec_ref = nullptr,
+				};
+				options::filter_state_t fs{
+					.accept = false,
+					.recurse_into = false,
+					.stop_scan_for_this_spec = false,
+					.do_report_progress = true,
+				};
+
+				if (fs.do_report_progress && !cache.default_callbacks) {
+					fill_info_paths(cache, fi);
+					if (!search_spec.progress_reporting(fi, fs))
+						return false;
+				}
+			}
+			return false;
+		}
+
+		// Queue `state` for scanning `basepath`. Leading literal segments are resolved right away, so the queued searchspec
+		// is keyed by the directory which will actually be listed: that's what makes merging overlapping specs possible.
+		void queue_searchspec(cached_options &cache, searchspec &&spec) {
+			const fs::path::string_type &text = spec.basepath.native();
+
+			// a subdirectory of the directory being scanned is stored as the text it appends to that directory.
+			const fs::path::string_type &parent = cache.scanning_path;
+			const bool below_scanning = cache.scanning >= 0 && text.size() > parent.size() && text.compare(0, parent.size(), parent) == 0 &&
+				(is_separator(text[parent.size()]) || is_separator(parent.back()));
+			auto [directories, guard] = lock_directories(cache);
+			const int directory = (below_scanning ?
+				directories.add(cache.scanning, directory_table::string_view_type(text).substr(parent.size()), cache.merge_specs) :
+				directories.add(-1, text, cache.merge_specs));
+
+			if (cache.merge_specs) {
+				auto [it, added] = cache.pending.try_emplace(directory, cache.searchpaths_popped + (int)cache.searchpaths.size());
+				if (!added) {
+					queued_searchspec &pending = cache.searchpaths[it->second - cache.searchpaths_popped];
+					pending.states.append(spec.states);
+					pending.basepath_exists |= spec.basepath_exists;
+					directories.release(directory);
+					return;
+				}
+			}
+
+			cache.searchpaths.push_back(queued_searchspec{
+				.directory = directory,
+				.basepath_exists = spec.basepath_exists,
+				.states = std::move(spec.states),
+			});
+			cache.searchpath_count++;
+		}
+
+		// Resolve `state` to the segments which have to be matched against a directory: a literal segment which is not the last one
+		// just extends `basepath`, while brace alternatives continue with each of their branches. The branches which end up in the
+		// same directory share a single searchspec, so that directory is only listed once.
+		void resolve_state(const spec_program &program, fs::path basepath, scan_state state, bool basepath_exists, std::vector<searchspec> &resolved) {
+			const spec_segment &seg = program.segments[state.segment];
+			if (seg.kind == spec_segment::alternatives) {
+				for (int branch : seg.branches) {
+					resolve_state(program, basepath, {state.program, branch, state.actual_depth}, basepath_exists, resolved);
+				}
+				return;
+			}
+			if (seg.kind == spec_segment::literal && !seg.is_last) {
+				resolve_state(program, basepath / seg.text, {state.program, seg.next, state.actual_depth}, false, resolved);
+				return;
+			}
+
+			for (auto &spec : resolved) {
+				if (spec.basepath.native() == basepath.native()) {
+					spec.states.push_back(state);
+					spec.basepath_exists |= basepath_exists;
+					return;
+				}
+			}
+			resolved.push_back(searchspec{
+				.basepath = std::move(basepath),
+				.states = {state},
+				.basepath_exists = basepath_exists,
+			});
+		}
+
+		void queue_state(cached_options &cache, fs::path basepath, scan_state state, bool basepath_exists) {
+			const spec_program &program = cache.programs[state.program];
+			const spec_segment &seg = program.segments[state.segment];
+			if (seg.kind == spec_segment::alternatives || (seg.kind == spec_segment::literal && !seg.is_last)) {
+				std::vector<searchspec> resolved;
+				resolve_state(program, std::move(basepath), state, basepath_exists, resolved);
+				for (auto &spec : resolved) {
+					queue_searchspec(cache, std::move(spec));
+				}
+				return;
+			}
+
+			queue_searchspec(cache, searchspec{
+				.basepath = std::move(basepath),
+				.states = {state},
+				.basepath_exists = basepath_exists,
+			});
+		}
+
+		enum class scan_result {
+			carry_on,
+			stop_scan_for_this_spec,
+			abort,
+		};
+
+		// Process a last, literal, spec segment, e.g. "CMakeLists.txt" in "**/CMakeLists.txt": it only has to check for its existence.
+		scan_result scan_literal(cached_options &cache, options &search_spec, const fs::path &basepath, const scan_state &state) {
+			const spec_program &program = cache.programs[state.program];
+			const spec_segment &seg = program.segments[state.segment];
+
+			fs::directory_entry entry;
+			bool is_dir;
+
+			if (cache.native_reader) {
+				if (!probe_entry(cache, basepath, seg.text, is_dir))
+					return scan_result::carry_on;
+			}
+			else {
+				const fs::path path = basepath / seg.text;
+
+				bool base_exists = fs::exists(path);
+				if (!base_exists)
+					return scan_result::carry_on;
+
+				entry = fs::directory_entry(path);
+				is_dir = entry.is_directory();
+			}
+
+			// the full path is only constructed once we know the entry exists.
+			fs::path path = basepath / seg.text;
+
+			if (is_dir)
+				cache.dir_count_scanned++;
+			else
+				cache.item_count_scanned++;
+
+			options::filter_info_t fi{
+				.fragment_is_wildcarded = false,
+				.fragment_is_double_star = false,
+
+				//.userland_may_override_accept = true,
+				.userland_may_override_recurse_into = is_dir,
+
+				.is_directory = is_dir,
+				.is_hidden = is_hidden(path),
+
+				.depth = state.actual_depth,
+				.max_recursion_depth = program.max_recursion_depth,
+
+				.item_count_scanned = cache.item_count_scanned,
+				.dir_count_scanned = cache.dir_count_scanned,
+
+				.original_search_spec_index = program.original_spec_index,
+				.actual_search_spec_index = cache.searchpath_index,
+				.search_spec_count = search_spec_count(cache),
+
+				.traversal = cache.traversal,
+
+				.basepath_ref = &basepath,
+				.item_relpath_ref = &seg.text,
+				.item_name = {},
+				.entry_ref = (cache.native_reader ? nullptr : &entry),
+
+				.matching_wildcarded_fragment_ref = &seg.text,
+				.subsearch_spec_ref = nullptr,
+			};
+			// Note: patterns ending with a slash should match only directories.
+			options::filter_state_t fs{
+				.accept = (search_spec.include_hidden_entries || !fi.is_hidden) &&
+									(is_dir ? search_spec.include_matching_directories : search_spec.include_matching_files && !seg.accepts_directories_only /* && fs::exists(path) */ ),
+				.recurse_into = false,
+				.stop_scan_for_this_spec = false,
+				.do_report_progress = false,
+			};
+			if (!cache.default_callbacks) {
+				fill_info_paths(cache, fi);
+				fs = search_spec.filter(path, fs, fi);
+			}
+
+			if (fs.accept) {
+				add_result(cache, path);
+			}
+
+			// Note: we do accept a 'recurse_info' override by userland filter here anyway, while the original search spec didn't mandate/suppose that sort of thing.
+			// Userland overrides work both ways...
+			if (fs.recurse_into && is_dir && state.actual_depth < program.max_recursion_depth) {
+				queue_state(cache, path, {state.program, program.override_segment, state.actual_depth + 1}, true);
+			}
+
+			if (fs.do_report_progress) {
+				//.current_path = path,
+				if (!search_spec.progress_reporting(fi, fs))
+					return scan_result::abort;
+			}
+
+			if (fs.stop_scan_for_this_spec) {
+				return scan_result::stop_scan_for_this_spec;
+			}
+			return scan_result::carry_on;
+		}
+
+		// Process a '**' spec segment for the directory itself: '**' MAY also match empty/NIL, i.e. '**' matching exactly *nothing*.
+		//
+		// When that match leads on to a next segment which must be matched against the same directory, that state is
+		// added to `same_dir_states`, if provided, instead of being queued.
+		//
+		// `base_is_dir` is only used by the native directory reader: it already knows whether `basepath` is a directory.
+		scan_result scan_double_star_self(cached_options &cache, options &search_spec, const fs::path &basepath, bool base_is_dir, const scan_state &state, scan_state_list *same_dir_states) {
+			const spec_program &program = cache.programs[state.program];
+			const spec_segment &seg = program.segments[state.segment];
+
+			fs::directory_entry entry;
+			bool is_dir = base_is_dir;
+			if (!cache.native_reader) {
+				entry = fs::directory_entry(basepath);
+				is_dir = entry.is_directory();
+			}
+
+			if (is_dir)
+				cache.dir_count_scanned++;
+			else
+				cache.item_count_scanned++;
+
+			options::filter_info_t fi{
+				.fragment_is_wildcarded = true,
+				.fragment_is_double_star = true,
+
+				//.userland_may_override_accept = true,
+				.userland_may_override_recurse_into = is_dir,
+
+				.is_directory = is_dir,
+				.is_hidden = is_hidden(basepath),
+
+				.depth = state.actual_depth,
+				.max_recursion_depth = program.max_recursion_depth,
+
+				.item_count_scanned = cache.item_count_scanned,
+				.dir_count_scanned = cache.dir_count_scanned,
+
+				.original_search_spec_index = program.original_spec_index,
+				.actual_search_spec_index = cache.searchpath_index,
+				.search_spec_count = search_spec_count(cache),
+
+				.traversal = cache.traversal,
+
+				.basepath_ref = &basepath,
+				.item_relpath_ref = nullptr,
+				.item_name = {},
+				.entry_ref = (cache.native_reader ? nullptr : &entry),
+
+				.matching_wildcarded_fragment_ref = &seg.text,
+				.subsearch_spec_ref = &seg.rest,
+			};
+			// Note: patterns ending with a slash should match only directories.
+			options::filter_state_t fs{
+				.accept = (search_spec.include_hidden_entries || !fi.is_hidden) &&
+									seg.is_last &&
+									(is_dir ? search_spec.include_matching_directories : search_spec.include_matching_files && !seg.accepts_directories_only /* && fs::exists(basepath) */),
+				.recurse_into = is_dir,
+				.stop_scan_for_this_spec = false,
+				.do_report_progress = false,
+			};
+			if (!cache.default_callbacks) {
+				fill_info_paths(cache, fi);
+				fs = search_spec.filter(basepath, fs, fi);
+			}
+
+			if (fs.accept) {
+				add_result(cache, basepath);
+			}
+
+			if (fs.recurse_into && is_dir) {
+				// this effectively drops the '**' from the search path...
+				scan_state next{state.program, seg.next, state.actual_depth};
+				const spec_segment &next_seg = program.segments[seg.next];
+				if (same_dir_states && next_seg.kind != spec_segment::alternatives && !(next_seg.kind == spec_segment::literal && !next_seg.is_last)) {
+					same_dir_states->push_back(next);
+				}
+				else {
+					queue_state(cache, basepath, next, true);
+				}
+			}
+
+			if (fs.do_report_progress) {
+				//.current_path = basepath,
+				if (!search_spec.progress_reporting(fi, fs))
+					return scan_result::abort;
+			}
+
+			if (fs.stop_scan_for_this_spec) {
+				return scan_result::stop_scan_for_this_spec;
+			}
+			return scan_result::carry_on;
+		}
+
+		// A directory entry as seen by scan_entry(): the full path is only constructed once it's actually needed.
+		// Its name is matched straight from the directory reader's buffer; the `fs::path` objects are only constructed
+		// for the entries which make it to filter().
+		struct entry_ref {
+			const fs::path &basepath;
+			std::string_view name;
+			const fs::directory_entry *entry;		// NULL when the directory is listed by the native directory reader.
+			std::optional<file_id> id;					// `dedup_mode::file`: as far as the directory reader knows it
+
+			const fs::path &path() const {
+				if (entry)
+					return entry->path();
+				if (joined.empty())
+					joined = basepath / relpath();
+				return joined;
+			}
+
+			const fs::path &relpath() const {
+				if (rel.empty())
+					rel = fs::path(name);
+				return rel;
+			}
+
+			mutable fs::path joined{};	// cache for path()
+			mutable fs::path rel{};			// cache for relpath()
+		};
+
+		// \return the `filter_info_t` for the entry `name` of `basepath`, matched against the '**' or wildcard segment of `state`.
+		options::filter_info_t entry_info(const cached_options &cache, const fs::path &basepath, const scan_state &state, std::string_view name,
+																			const fs::directory_entry *entry, bool is_dir, bool entry_is_hidden) {
+			const spec_program &program = cache.programs[state.program];
+			const spec_segment &seg = program.segments[state.segment];
+			// '**' and wildcarded directory elements only ever see directories, which lead on to the next level.
+			const bool leads_on = (seg.kind == spec_segment::double_star || !seg.is_last);
+
+			options::filter_info_t info{
+				.fragment_is_wildcarded = true,
+				.fragment_is_double_star = (seg.kind == spec_segment::double_star),
+
+				//.userland_may_override_accept = (seg.kind != spec_segment::double_star),
+				.userland_may_override_recurse_into = leads_on || is_dir,
+
+				.is_directory = is_dir,
+				.is_hidden = (seg.kind == spec_segment::double_star ? is_hidden(basepath) : entry_is_hidden),
+
+				.depth = state.actual_depth + (leads_on ? 1 : 0),
+				.max_recursion_depth = program.max_recursion_depth,
+
+				.item_count_scanned = cache.item_count_scanned,
+				.dir_count_scanned = cache.dir_count_scanned,
+
+				.original_search_spec_index = program.original_spec_index,
+				.actual_search_spec_index = cache.searchpath_index,
+				.search_spec_count = search_spec_count(cache),
+
+				.traversal = cache.traversal,
+
+				.basepath_ref = &basepath,
+				.item_relpath_ref = nullptr,
+				.item_name = name,
+				.entry_ref = entry,
+
+				.matching_wildcarded_fragment_ref = &seg.text,
+				.subsearch_spec_ref = (leads_on ? &seg.rest : nullptr),
+			};
+			fill_info_paths(cache, info);
+			return info;
+		}
+
+		// Act on the (userland filtered) verdict `fs` for the entry `ref`, as produced by scan_entry(). `fi` is only used for progress reports,
+		// hence it may be NULL when those aren't requested.
+		scan_result apply_entry_verdict(cached_options &cache, options &search_spec, const scan_state &state, const entry_ref &ref, bool is_dir,
+																		options::filter_state_t fs, const options::filter_info_t *fi) {
+			const spec_program &program = cache.programs[state.program];
+			const spec_segment &seg = program.segments[state.segment];
+
+			if (fs.accept) {
+				add_result(cache, ref.path(), ref.id);
+			}
+
+			// Note: for the last segment we do accept a 'recurse_info' override by userland filter here anyway, while the original search spec
+			// didn't mandate/suppose that sort of thing. Userland overrides work both ways...
+			if (fs.recurse_into && is_dir && state.actual_depth < program.max_recursion_depth) {
+				if (seg.kind == spec_segment::double_star) {
+					// also queue another level of "**" scanning in this subdirectory...
+					queue_state(cache, ref.path(), {state.program, seg.recurse, state.actual_depth + 1}, true);
+				}
+				else {
+					queue_state(cache, ref.path(), {state.program, (seg.is_last ? program.override_segment : seg.next), state.actual_depth + 1}, true);
+				}
+			}
+
+			if (fs.do_report_progress) {
+				assert(fi);
+				//.current_path = ref.path(),
+				if (!search_spec.progress_reporting(*fi, fs))
+					return scan_result::abort;
+			}
+
+			if (fs.stop_scan_for_this_spec) {
+				return scan_result::stop_scan_for_this_spec;
+			}
+			return scan_result::carry_on;
+		}
+
+		// `options::use_batch_filter`: the entries of a directory which one spec state has been matched against, awaiting `filter_batch()`.
+		struct directory_batch {
+			std::string names;												// the entry names, back to back: the directory reader reuses its buffer
+			std::vector<std::size_t> name_ends;
+			std::vector<options::batch_entry_t> entries;		// their `name` is set once the listing is complete and `names` won't move anymore
+			std::vector<std::optional<file_id>> ids;
+		};
+
+		// Match a single directory entry against a '**' or wildcard spec segment. With a `batch`, the verdict is added to it rather than acted upon.
+		scan_result scan_entry(cached_options &cache, options &search_spec, const fs::path &basepath, const scan_state &state,
+													 const entry_ref &ref, bool is_dir, bool entry_is_hidden, directory_batch *batch) {
+			const spec_program &program = cache.programs[state.program];
+			const spec_segment &seg = program.segments[state.segment];
+			const std::string_view name = ref.name;
+
+			options::filter_state_t fs;
+			if (seg.kind == spec_segment::double_star) {
+				// the "**" element: scan the current directory for any subdirectories and recurse into them.
+				// Do this recursively as "**" can match multiple levels of path hierarchy.
+				if (!is_dir)
+					return scan_result::carry_on;
+
+				fs = {
+					.accept = (search_spec.include_hidden_entries || !is_hidden(basepath)) &&
+										seg.is_last &&
+										search_spec.include_matching_directories,
+					.recurse_into = true,
+					.stop_scan_for_this_spec = false,
+					.do_report_progress = false,
+				};
+			}
+			else {
+				assert(seg.kind == spec_segment::wildcard);
+
+				// we are NOT processing a '**' wildcard, but a (wildcarded) subspec instead, e.g. "*bla*/reutel.pdf" or "*ska*.mp3"...
+				if (!seg.is_last) {
+					// scan wildcarded directory spec element, e.g. "*bla*/" in "*bla*/reutel.pdf", hence we will only accept matching directory names here.
+					if (!is_dir)
+						return scan_result::carry_on;
+
+					fs = {
+						.accept = false,
+						.recurse_into = fnmatch(name, *seg.matcher),
+						.stop_scan_for_this_spec = false,
+						.do_report_progress = false,
+					};
+				}
+				else {
+					// scan wildcarded filename spec element, e.g. "*ska*.mp3", hence we will accept both matching files and matching directory names here.
+					fs = {
+						.accept = (search_spec.include_hidden_entries || !entry_is_hidden) &&
+											(is_dir ? search_spec.include_matching_directories : search_spec.include_matching_files && !seg.accepts_directories_only /* && fs::exists(path) */) &&
+											fnmatch(name, *seg.matcher),
+						.recurse_into = false,
+						.stop_scan_for_this_spec = false,
+						.do_report_progress = false,
+					};
+				}
+			}
+
+			if (batch) {
+				batch->names.append(name);
+				batch->name_ends.push_back(batch->names.size());
+				batch->entries.push_back(options::batch_entry_t{
+					.name = {},
+					.is_directory = is_dir,
+					.is_hidden = entry_is_hidden,
+					.verdict = fs,
+				});
+				batch->ids.push_back(ref.id);
+				return scan_result::carry_on;
+			}
+
+			// the default callbacks pass `fs` on as is, without requesting a progress report.
+			if (cache.default_callbacks)
+				return apply_entry_verdict(cache, search_spec, state, ref, is_dir, fs, nullptr);
+
+			const options::filter_info_t fi = entry_info(cache, basepath, state, name, ref.entry, is_dir, entry_is_hidden);
+			fs = search_spec.filter(ref.path(), fs, fi);
+			return apply_entry_verdict(cache, search_spec, state, ref, is_dir, fs, &fi);
+		}
+
+		// Hand the entries collected in `batch` to `filter_batch()` and act on the verdicts it returns, in listing order.
+		scan_result apply_batch(cached_options &cache, options &search_spec, const fs::path &basepath, const scan_state &state, directory_batch &batch) {
+			if (batch.entries.empty())
+				return scan_result::carry_on;
+
+			std::size_t begin = 0;
+			for (std::size_t index = 0; index < batch.entries.size(); index++) {
+				batch.entries[index].name = std::string_view(batch.names).substr(begin, batch.name_ends[index] - begin);
+				begin = batch.name_ends[index];
+			}
+
+			const spec_program &program = cache.programs[state.program];
+			const spec_segment &seg = program.segments[state.segment];
+			options::filter_info_t dir_info{
+				.fragment_is_wildcarded = true,
+				.fragment_is_double_star = (seg.kind == spec_segment::double_star),
+
+				.userland_may_override_recurse_into = true,
+
+				.is_directory = true,
+				.is_hidden = is_hidden(basepath),
+
+				.depth = state.actual_depth,
+				.max_recursion_depth = program.max_recursion_depth,
+
+				.item_count_scanned = cache.item_count_scanned,
+				.dir_count_scanned = cache.dir_count_scanned,
+
+				.original_search_spec_index = program.original_spec_index,
+				.actual_search_spec_index = cache.searchpath_index,
+				.search_spec_count = search_spec_count(cache),
+
+				.traversal = cache.traversal,
+
+				.basepath_ref = &basepath,
+				.item_relpath_ref = nullptr,
+				.item_name = {},
+				.entry_ref = nullptr,
+
+				.matching_wildcarded_fragment_ref = &seg.text,
+				.subsearch_spec_ref = (seg.is_last ? nullptr : &seg.rest),
+			};
+			fill_info_paths(cache, dir_info);
+			search_spec.filter_batch(basepath, options::batch_entries_t{batch.entries.data(), batch.entries.size()}, dir_info);
+
+			for (std::size_t index = 0; index < batch.entries.size(); index++) {
+				const auto &candidate = batch.entries[index];
+				const entry_ref ref{basepath, candidate.name, nullptr, batch.ids[index]};
+				std::optional<options::filter_info_t> fi;
+				if (candidate.verdict.do_report_progress)
+					fi = entry_info(cache, basepath, state, candidate.name, nullptr, candidate.is_directory, candidate.is_hidden);
+				auto rv = apply_entry_verdict(cache, search_spec, state, ref, candidate.is_directory, candidate.verdict, fi ? &*fi : nullptr);
+				if (rv != scan_result::carry_on)
+					return rv;
+			}
+			return scan_result::carry_on;
+		}
+
+		// preparation / init phase: parse the search specs and queue their starting points.
+		void prepare_search(cached_options &cache, options &search_spec) {
+			cache.basepath = search_spec.basepath;
+			if (!cache.basepath.empty())
+				cache.basepath = expand_tilde(cache.basepath);
+
+			cache.merge_specs = search_spec.merge_overlapping_specs;
+			cache.default_callbacks = (typeid(search_spec) == typeid(options));
+			cache.copy_info_paths = search_spec.copy_filter_info_paths;
+			cache.dedup = search_spec.deduplicate;
+			cache.matching = (search_spec.case_insensitive ? match_flags::case_insensitive : match_flags::none) |
+				(search_spec.extglob ? match_flags::extglob : match_flags::none) |
+				(search_spec.brace_expansion ? match_flags::brace_expansion : match_flags::none);
+			cache.native_reader = GLOB_HAS_NATIVE_DIRECTORY_READER && search_spec.use_native_directory_reader;
+			cache.use_io_uring = GLOB_HAS_IO_URING && cache.native_reader && search_spec.use_io_uring;
+
+			for (const auto &matcher : search_spec.precompiled_matchers) {
+				// a matcher compiled for the other case mode would give different answers: leave those to `shared_matcher()`.
+				if (matcher.case_insensitive() == has_flag(cache.matching, match_flags::case_insensitive) &&
+						matcher.extglob() == has_flag(cache.matching, match_flags::extglob) &&
+						matcher.braces() == has_flag(cache.matching, match_flags::brace_expansion))
+					cache.matchers.emplace(matcher.pattern(), matcher);
+			}
+
+			for (int index = 0; index < search_spec.pathnames.size(); index++) {
+				fs::path pn = search_spec.pathnames[index];
+				pn = expand_tilde(pn);
+
+				if (pn.empty()) {
+					pn = fs::current_path();
+				}
+
+				int max_depth = search_spec.max_recursion_depth[index];
+				if (max_depth < 0)
+					max_depth = INT_MAX;
+
+				// help detect whether the search spec ended with an '/' or equivalent directory separator:
+				const auto basename = pn.filename().string();
+
+				// brace alternatives which are relative and those which are absolute (rare) need a program each.
+				std::vector<fs::path> expansions = expand_spec_braces(pn, cache.matching);
+				std::vector<fs::path> groups[2];
+				for (auto &expansion : expansions) {
+					groups[expansion.is_relative() == pn.is_relative() ? 0 : 1].push_back(std::move(expansion));
+				}
+
+				for (const auto &group : groups) {
+					if (group.empty())
+						continue;
+
+					spec_program program = parse_spec(cache, group, basename.empty());
+					program.basepath = (group[0].is_relative() ? cache.basepath : "");
+					program.max_recursion_depth = max_depth;
+					program.original_spec_index = index;
+					cache.programs.push_back(std::move(program));
+
+					queue_state(cache, cache.programs.back().basepath, {(int)cache.programs.size() - 1, 0, 0}, false);
+				}
+			}
+
+			cache.item_count_scanned = 0;
+			cache.dir_count_scanned = 0;
+
+			cache.report_100pct_done_pending = true;
+		}
+
+		// Scan `basepath` for the spec programs in `states`. Returns `false` when userland aborted the glob action.
+		bool scan_directory(cached_options &cache, options &search_spec, const fs::path &basepath, scan_state_list &states, bool basepath_exists) {
+
+			// first handle everything which doesn't need a directory scan; the remaining states are
+			// collected in `listing` and served by a single scan of the directory.
+			scan_state_list listing;
+			std::vector<directory_batch> batches;
+
+			try {
+				// a basepath which is known to exist is always a directory we queued while scanning its parent.
+				bool base_is_dir = true;
+
+				for (std::size_t index = 0; index < states.size(); index++) {
+					const scan_state state = states[index];
+					const spec_program &program = cache.programs[state.program];
+
+					if (state.actual_depth > program.max_recursion_depth)
+						continue;
+
+					const spec_segment &seg = program.segments[state.segment];
+
+					if (seg.kind == spec_segment::literal) {
+						assert(seg.is_last);
+						if (scan_literal(cache, search_spec, basepath, state) == scan_result::abort)
+							return false;
+						continue;
+					}
+
+					if (!basepath_exists)
+					{
+						bool base_exists = (cache.native_reader ? probe_entry(cache, basepath.parent_path(), basepath.filename(), base_is_dir) : fs::exists(basepath));
+						if (!base_exists)
+							return true;
+						basepath_exists = true;
+					}
+
+					if (seg.kind == spec_segment::double_star) {
+						auto rv = scan_double_star_self(cache, search_spec, basepath, base_is_dir, state, cache.merge_specs ? &states : nullptr);
+						if (rv == scan_result::abort)
+							return false;
+						if (rv == scan_result::stop_scan_for_this_spec)
+							continue;
+					}
+
+					listing.push_back(state);
+				}
+
+				if (listing.empty())
+					return true;
+
+				std::vector<bool> active(listing.size(), true);
+				std::size_t active_count = listing.size();
+
+				// `options::use_batch_filter`: the verdicts are collected per spec state and acted upon once the listing is complete.
+				if (search_spec.use_batch_filter && !cache.default_callbacks)
+					batches.resize(listing.size());
+
+#if GLOB_HAS_NATIVE_DIRECTORY_READER
+				if (cache.use_io_uring && !cache.statx_ring) {
+					cache.statx_ring = std::make_unique<statx_batch>();
+				}
+				directory_reader reader = (cache.native_reader ? directory_reader(open_directory(cache, basepath), basepath, cache.dirent_buffer, cache.statx_ring.get()) : directory_reader(basepath, false, cache.dirent_buffer));
+#else
+				directory_reader reader(basepath, false, cache.dirent_buffer);
+#endif
+				// serve a single entry to every spec state which is still active: `stop_scan_for_this_spec` once none is left.
+				const bool identify = (cache.dedup == dedup_mode::file);
+				auto serve_entry = [&](std::string_view name, bool is_dir, const fs::directory_entry *entry, std::optional<file_id> id) {
+					if (is_dir)
+						cache.dir_count_scanned++;
+					else
+						cache.item_count_scanned++;
+
+#if DO_DEBUG
+					if (cache.item_count_scanned > 30000)
+						return scan_result::stop_scan_for_this_spec;
+#endif
+
+					const bool entry_is_hidden = is_hidden(name);
 
-			searchspec pathspec = cache.searchpaths[cache.searchpath_index];
-			if (pathspec.actual_depth > pathspec.max_recursion_depth)
-				return true;
+					const entry_ref ref{basepath, name, entry, id};
 
-			try {
-				assert(!pathspec.deep_spec.empty());
+					for (std::size_t index = 0; index < listing.size(); index++) {
+						if (!active[index])
+							continue;
 
-				if (!has_magic(pathspec.deep_spec)) {
-					assert(!has_magic(pathspec.basepath));
+						auto rv = scan_entry(cache, search_spec, basepath, listing[index], ref, is_dir, entry_is_hidden, batches.empty() ? nullptr : &batches[index]);
+						if (rv == scan_result::abort)
+							return scan_result::abort;
+						if (rv == scan_result::stop_scan_for_this_spec) {
+							active[index] = false;
+							active_count--;
+						}
+					}
 
-					fs::path path = pathspec.basepath / pathspec.deep_spec;
+					return (active_count == 0 ? scan_result::stop_scan_for_this_spec : scan_result::carry_on);
+				};
 
-					//if (!pathspec.basepath_exists + exists:?:deep_spec)
-					{
-						bool base_exists = fs::exists(path);
-						if (!base_exists)
-							return true;
+				if (search_spec.ordering == result_order::directory) {
+					sorted_listing entries;
+					while (reader.next()) {
+						entries.add(reader, identify);
+					}
+					for (std::size_t index : entries.order()) {
+						auto rv = serve_entry(entries.name(index), entries.is_dir[index], entries.entry(index), entries.id(index));
+						if (rv == scan_result::abort)
+							return false;
+						if (rv == scan_result::stop_scan_for_this_spec)
+							break;
+					}
+				}
+				else {
+					while (reader.next()) {
+						auto rv = serve_entry(reader.name(), reader.is_directory(), reader.entry(), identify ? reader.identify() : std::nullopt);
+						if (rv == scan_result::abort)
+							return false;
+						if (rv == scan_result::stop_scan_for_this_spec)
+							break;
 					}
+				}
+			}
+			catch (std::exception& ex) {
+				// not a directory
+				// do nothing
+				auto msg = std::format("{}: {}\n", basepath.string(), ex.what());
+				cache.error_msg.push_back(msg);
+			}
 
-					fs::directory_entry entry(path);
+			// as with per-entry filtering, the entries listed before an error are still served.
+			for (std::size_t index = 0; index < batches.size(); index++) {
+				if (apply_batch(cache, search_spec, basepath, listing[index], batches[index]) == scan_result::abort)
+					return false;
+			}
 
-					bool is_dir = entry.is_directory();
+			return true;
+		}
 
-					if (is_dir)
-						cache.dir_count_scanned++;
-					else
-						cache.item_count_scanned++;
+		// Scan a single queued searchspec. Returns `false` when userland aborted the glob action.
+		bool scan_searchspec(cached_options &cache, options &search_spec, queued_searchspec &pathspec) {
+			fs::path basepath;
+			{
+				auto [directories, guard] = lock_directories(cache);
+				basepath = directories.path(pathspec.directory);
+			}
+			if (cache.merge_specs) {
+				cache.pending.erase(pathspec.directory);
+			}
 
-					options::filter_info_t fi{
-						.basepath = pathspec.basepath,
-						.item_relpath = pathspec.deep_spec,
-						.entry = entry,
+			cache.scanning = pathspec.directory;
+			cache.scanning_path = basepath.native();
+			const bool carry_on = scan_directory(cache, search_spec, basepath, pathspec.states, pathspec.basepath_exists);
+			cache.scanning = -1;
 
-						.matching_wildcarded_fragment = pathspec.deep_spec,
-						.subsearch_spec = "",
+			// the directories queued while scanning keep their parent node alive.
+			auto [directories, guard] = lock_directories(cache);
+			directories.release(pathspec.directory);
+			return carry_on;
+		}
 
-						.fragment_is_wildcarded = false,
-						.fragment_is_double_star = false,
+#if GLOB_HAS_IO_URING
+		// `options::use_io_uring`: start opening the directories which are up for scanning after the one just taken from the queue.
+		void prefetch_directories(cached_options &cache, bool depth_first) {
+			if (!cache.prefetch)
+				cache.prefetch = std::make_unique<open_prefetch>();
+			const std::size_t count = std::min<std::size_t>(cache.searchpaths.size(), OPEN_PREFETCH_RING_SIZE);
+			for (std::size_t n = 0; n < count && cache.prefetch->has_room(); n++) {
+				const queued_searchspec &next = cache.searchpaths[depth_first ? cache.searchpaths.size() - 1 - n : n];
+				// the initial searchspecs may name directories which don't exist.
+				if (!next.basepath_exists)
+					continue;
+				const fs::path dir = cache.directories.path(next.directory);
+				if (!cache.dirfds.contains(dir))
+					cache.prefetch->add(dir);
+			}
+			cache.prefetch->submit();
+		}
+#endif
 
-						//.userland_may_override_accept = true,
-						.userland_may_override_recurse_into = is_dir,
+		bool glob_42(cached_options &cache, options &search_spec) {
+			if (cache.searchpath_index < 0) {
+				prepare_search(cache, search_spec);
+				cache.searchpath_index = 0;
+			}
 
-						.is_directory = is_dir,
-						.is_hidden = is_hidden(path),
+			if (cache.searchpaths.empty())
+				return report_100_pct_done(cache, search_spec);
 
-						.depth = pathspec.actual_depth,
-						.max_recursion_depth = pathspec.max_recursion_depth,
+			// `result_order::directory` is a depth first walk of the sorted directory listings.
+			const traversal_order traversal = (search_spec.ordering == result_order::directory ? traversal_order::depth_first : search_spec.traversal);
+			const bool depth_first = traversal == traversal_order::depth_first ||
+				(traversal == traversal_order::hybrid && (int)cache.searchpaths.size() > search_spec.hybrid_queue_limit);
+			cache.traversal = (depth_first ? traversal_order::depth_first : traversal_order::breadth_first);
+
+			// a depth first scan continues with the first subdirectory found, rather than the last one: the results of every single directory
+			// are then reported in the same order as with a breadth first scan.
+			if (traversal == traversal_order::depth_first && cache.searchpaths.size() - cache.searchpaths_unordered > 1) {
+				std::reverse(cache.searchpaths.begin() + cache.searchpaths_unordered, cache.searchpaths.end());
+				if (cache.merge_specs) {
+					for (std::size_t index = cache.searchpaths_unordered; index < cache.searchpaths.size(); index++) {
+						cache.pending[cache.searchpaths[index].directory] = cache.searchpaths_popped + (int)index;
+					}
+				}
+			}
 
-						.item_count_scanned = cache.item_count_scanned,
-						.dir_count_scanned = cache.dir_count_scanned,
+			// this queue entry won't be visited again, so we can take its content.
+			queued_searchspec pathspec;
+			if (depth_first) {
+				pathspec = std::move(cache.searchpaths.back());
+				cache.searchpaths.pop_back();
+			}
+			else {
+				pathspec = std::move(cache.searchpaths.front());
+				cache.searchpaths.pop_front();
+				cache.searchpaths_popped++;
+			}
+			cache.searchpaths_unordered = cache.searchpaths.size();
 
-						.original_search_spec_index = pathspec.original_spec_index,
-						.actual_search_spec_index = cache.searchpath_index,
-						.search_spec_count = (int)cache.searchpaths.size(),
-					};
-					// Note: patterns ending with a slash should match only directories.
-					options::filter_state_t fs{
-						.accept = (search_spec.include_hidden_entries || !fi.is_hidden) &&
-											(is_dir ? search_spec.include_matching_directories : search_spec.include_matching_files && !pathspec.accepts_directories_only /* && fs::exists(path) */ ),
-						.recurse_into = false,
-						.stop_scan_for_this_spec = false,
-						.do_report_progress = false,
-					};
-					fs = search_spec.filter(path, fs, fi);
+#if GLOB_HAS_IO_URING
+			if (cache.native_reader && cache.use_io_uring)
+				prefetch_directories(cache, depth_first);
+#endif
+
+			return scan_searchspec(cache, search_spec, pathspec);
+		}
+
+		void wake_idle_workers(shared_run &run) {
+			{
+				// taking the lock ensures a worker which is about to wait has either seen our update or will receive the notification.
+				std::lock_guard<std::mutex> guard(run.idle_lock);
+			}
+			run.idle_cv.notify_all();
+		}
+
+		void abort_run(shared_run &run) {
+			run.aborted = true;
+			wake_idle_workers(run);
+		}
 
-					if (fs.accept) {
-						cache.result_set.push_back(path);
+		// Move the searchspecs queued by the worker `self` while scanning its latest directory into its deque.
+		void push_work(shared_run &run, int self, cached_options &cache) {
+			const int count = (int)cache.searchpaths.size();
+			if (count > 0) {
+				run.outstanding += count;
+				run.total += count;
+				{
+					work_deque &own = run.deques[self];
+					std::lock_guard<std::mutex> guard(own.lock);
+					for (auto &spec : cache.searchpaths) {
+						own.items.push_back(std::move(spec));
 					}
+				}
+				run.queued += count;
+				if (run.idle > 0)
+					wake_idle_workers(run);
+			}
+			cache.searchpaths.clear();
+			cache.pending.clear();
+		}
 
-					// Note: we do accept a 'recurse_info' override by userland filter here anyway, while the original search spec didn't mandate/suppose that sort of thing.
-					// Userland overrides work both ways...
-					if (fs.recurse_into && is_dir && pathspec.actual_depth < pathspec.max_recursion_depth) {
-						searchspec spec{
-							.basepath = path,
-							.deep_spec = "*",
-							.accepts_directories_only = false,   // we drop this requirement here as the userland override has us going out of original scope already.
-							.basepath_exists = true,
-							.actual_depth = pathspec.actual_depth + 1,
-							.max_recursion_depth = pathspec.max_recursion_depth,
-							.original_spec_index = pathspec.original_spec_index,
-						};
-						cache.searchpaths.push_back(spec);
+		// Take the next searchspec for worker `self`: its own most recent one, else the oldest one of another worker.
+		// Blocks while there's nothing to take, but other workers are still busy. Returns `false` when the run is done.
+		bool take_work(shared_run &run, int self, queued_searchspec &pathspec) {
+			const int count = (int)run.deques.size();
+			for (;;) {
+				if (run.aborted)
+					return false;
+
+				for (int i = 0; i < count; i++) {
+					work_deque &victim = run.deques[(self + i) % count];
+					std::lock_guard<std::mutex> guard(victim.lock);
+					if (!victim.items.empty()) {
+						if (i == 0) {
+							pathspec = std::move(victim.items.back());
+							victim.items.pop_back();
+						}
+						else {
+							pathspec = std::move(victim.items.front());
+							victim.items.pop_front();
+						}
+						run.queued--;
+						return true;
 					}
+				}
 
-					if (fs.do_report_progress) {
-						//.current_path = path,
-						if (!search_spec.progress_reporting(fi, fs))
-							return false;
+				std::unique_lock<std::mutex> lock(run.idle_lock);
+				run.idle++;
+				run.idle_cv.wait(lock, [&run]() {
+					return run.queued > 0 || run.outstanding == 0 || run.aborted;
+				});
+				run.idle--;
+				if (run.outstanding == 0)
+					return false;
+			}
+		}
+
+		void glob_worker(cached_options &cache, options &search_spec, shared_run &run, int self) {
+			try {
+				queued_searchspec pathspec;
+				while (take_work(run, self, pathspec)) {
+					cache.searchpath_index = run.started++;
+
+					// the counters reported to filter() are those of the entire run, as far as they're known at this point.
+					const int items_scanned = cache.item_count_scanned = run.item_count_scanned.load(std::memory_order_relaxed);
+					const int dirs_scanned = cache.dir_count_scanned = run.dir_count_scanned.load(std::memory_order_relaxed);
+
+					const bool carry_on = scan_searchspec(cache, search_spec, pathspec);
+
+					run.item_count_scanned += cache.item_count_scanned - items_scanned;
+					run.dir_count_scanned += cache.dir_count_scanned - dirs_scanned;
+
+					if (!carry_on) {
+						abort_run(run);
+						return;
 					}
 
-					if (fs.stop_scan_for_this_spec) {
+					push_work(run, self, cache);
+					if (--run.outstanding == 0)
+						wake_idle_workers(run);
+				}
+
+				// every worker sorts its own results, while glob_threaded() merely merges them.
+				sort_results(cache, search_spec.ordering);
+			}
+			catch (...) {
+				{
+					std::lock_guard<std::mutex> guard(run.error_lock);
+					if (!run.error)
+						run.error = std::current_exception();
+				}
+				abort_run(run);
+			}
+		}
+
+		// `glob(options&)` for `options::thread_count` > 1: the searchspecs are scanned by a pool of workers, which each own a deque of work.
+		std::vector<fs::path> glob_threaded(cached_options &cache, options &search_spec, int thread_count) {
+			shared_run run(thread_count);
+			const int count = (int)cache.searchpaths.size();
+			for (int index = 0; index < count; index++) {
+				run.deques[index % thread_count].items.push_back(std::move(cache.searchpaths[index]));
+			}
+			run.queued = count;
+			run.outstanding = count;
+			run.total = count;
+			run.directories = std::move(cache.directories);
+			cache.searchpaths.clear();
+			cache.pending.clear();
+
+			// every worker shares the parsed spec programs; their matchers remain owned by `cache`.
+			std::vector<cached_options> workers(thread_count);
+			// workers collect their results in an arena when the caller wants anything but a vector.
+			std::vector<path_arena> arenas(cache.arena || cache.tree ? thread_count : 0);
+			for (auto &worker : workers) {
+				if (!arenas.empty())
+					worker.arena = &arenas[&worker - workers.data()];
+				worker.basepath = cache.basepath;
+				worker.programs = cache.programs;
+				worker.merge_specs = cache.merge_specs;
+				worker.native_reader = cache.native_reader;
+				worker.use_io_uring = cache.use_io_uring;
+				worker.traversal = traversal_order::depth_first;
+				worker.default_callbacks = cache.default_callbacks;
+				worker.copy_info_paths = cache.copy_info_paths;
+				worker.dedup = cache.dedup;
+				worker.shared = &run;
+			}
+
+			if (count > 0) {
+				std::vector<std::thread> pool;
+				pool.reserve(thread_count);
+				for (int index = 0; index < thread_count; index++) {
+					pool.emplace_back(glob_worker, std::ref(workers[index]), std::ref(search_spec), std::ref(run), index);
+				}
+				for (auto &thread : pool) {
+					thread.join();
+				}
+			}
+
+			if (run.error)
+				std::rethrow_exception(run.error);
+
+			// `options::ordering`: the results of every worker form a sorted run.
+			const bool sorted = sorts_results(search_spec.ordering) && !run.aborted;
+			const pathname_less less{search_spec.ordering == result_order::natural};
+			std::vector<std::size_t> runs;
+
+			std::vector<path_arena::string_view_type> found;
+			for (auto &arena : arenas) {
+				found.insert(found.end(), arena.begin(), arena.end());
+				runs.push_back(found.size());
+			}
+			if (sorted && !arenas.empty())
+				merge_sorted_runs(found, runs, less, thread_count);
+			for (auto path : found) {
+				if (cache.arena)
+					cache.arena->push_back(path);
+				else
+					cache.tree->push_back(fs::path(path));
+			}
+
+			runs.clear();
+			for (auto &worker : workers) {
+				std::move(worker.result_set.begin(), worker.result_set.end(), std::back_inserter(cache.result_set));
+				std::move(worker.error_msg.begin(), worker.error_msg.end(), std::back_inserter(cache.error_msg));
+				runs.push_back(cache.result_set.size());
+			}
+			if (sorted && arenas.empty())
+				merge_sorted_runs(cache.result_set, runs, less, thread_count);
+
+			cache.shared = &run;
+			cache.traversal = traversal_order::depth_first;
+			cache.item_count_scanned = run.item_count_scanned;
+			cache.dir_count_scanned = run.dir_count_scanned;
+			if (!run.aborted)
+				report_100_pct_done(cache, search_spec);
+			cache.shared = nullptr;
+
+			return std::move(cache.result_set);
+		}
+
+		// Run the search prepared in `cache`, on the calling thread or on `options::thread_count` threads.
+		std::vector<fs::path> run_search(cached_options &cache, options &search_spec) {
+			int thread_count = search_spec.thread_count;
+			if (thread_count <= 0)
+				thread_count = std::max(1, (int)std::thread::hardware_concurrency());
+			// `result_order::directory` follows a single depth first walk.
+			if (thread_count > 1 && search_spec.ordering != result_order::directory)
+				return glob_threaded(cache, search_spec, thread_count);
+
+			cache.searchpath_index = 0;
+			while (glob_42(cache, search_spec)) {
+				cache.searchpath_index++;
+			}
+			sort_results(cache, search_spec.ordering);
+
+			return std::move(cache.result_set);
+		}
+
+	} // namespace end
+
+
+	//
+	// hotfix because on MS Windows some path' symlinks throw a spanner in the woodworks by being expanded, e.g.
+	//
+	//    fs::relative("C:\\Users\\All Users", "C:\\Users") != "All Users"
+	// 
+	// but returns "..\\ProgramData" instead, and we don't want that, hence we get rid of the implicit weak_canonical() calls
+	// applied to either path:
+	//
+	fs::path mk_relative(const fs::path& p, const fs::path& base) {
+		//return weakly_canonical(p).lexically_relative(weakly_canonical(base));
+		return p.lexically_relative(base);
+	}
+
+	std::string translate_pattern(std::string_view pattern) {
+		return translate(pattern);
+	}
+
+	std::regex compile_pattern(std::string_view pattern) {
+		return std::regex(translate(pattern), std::regex::ECMAScript);
+	}
+
+	bool fnmatch(std::string&& name, const std::regex& pattern) {
+		return std::regex_match(std::move(name), pattern);
+	}
+
+	namespace {
+
+		inline void set_add(std::array<uint64_t, 4> &set, unsigned char c) noexcept {
+			set[c >> 6] |= uint64_t(1) << (c & 63);
+		}
+
+		inline bool set_has(const std::array<uint64_t, 4> &set, unsigned char c) noexcept {
+			return (set[c >> 6] >> (c & 63)) & 1;
+		}
+
+		// \return the only member of `set`, or -1 when it has none or several.
+		int set_single(const std::array<uint64_t, 4> &set) noexcept {
+			int found = -1;
+			for (int word = 0; word < 4; word++) {
+				if (!set[word])
+					continue;
+				if (found >= 0 || std::popcount(set[word]) != 1)
+					return -1;
+				found = word * 64 + std::countr_zero(set[word]);
+			}
+			return found;
+		}
+
+		// memmem(): compare the first and last byte of `needle` at 16/32 positions at once and only verify the candidates
+		// which have both of them right. Falls back to the scalar search for the tail and when no SIMD is available.
+		bool contains_literal(std::string_view haystack, std::string_view needle) noexcept {
+			const std::size_t k = needle.size();
+			if (k == 0)
+				return true;
+			if (haystack.size() < k)
+				return false;
+
+			std::size_t i = 0;
+			const char *data = haystack.data();
+#if defined(GLOB_SIMD_AVX2)
+			const __m256i first = _mm256_set1_epi8(needle[0]);
+			const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+			for (; i + k - 1 + 32 <= haystack.size(); i += 32) {
+				const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+				const __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + k - 1));
+				uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+				while (mask) {
+					if (std::memcmp(data + i + std::countr_zero(mask), needle.data(), k) == 0)
+						return true;
+					mask &= mask - 1;
+				}
+			}
+#elif defined(GLOB_SIMD_SSE2)
+			const __m128i first = _mm_set1_epi8(needle[0]);
+			const __m128i last = _mm_set1_epi8(needle[k - 1]);
+			for (; i + k - 1 + 16 <= haystack.size(); i += 16) {
+				const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+				const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + k - 1));
+				uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+				while (mask) {
+					if (std::memcmp(data + i + std::countr_zero(mask), needle.data(), k) == 0)
+						return true;
+					mask &= mask - 1;
+				}
+			}
+#endif
+			return haystack.substr(i).find(needle) != std::string_view::npos;
+		}
+
+		constexpr std::array<unsigned char, 256> make_ascii_lower_table() noexcept {
+			std::array<unsigned char, 256> table{};
+			for (unsigned c = 0; c < 256; c++) {
+				table[c] = (unsigned char)(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+			}
+			return table;
+		}
+
+		constexpr std::array<unsigned char, 256> ascii_lower = make_ascii_lower_table();
+
+		constexpr bool is_ascii_letter(unsigned char c) noexcept {
+			return (unsigned char)((c | 0x20) - 'a') < 26;
+		}
+
+		// \return whether `name` consists of 7-bit ASCII only, checking 8 bytes at a time.
+		bool is_ascii(std::string_view name) noexcept {
+			const char *data = name.data();
+			std::size_t i = 0;
+			uint64_t bits = 0;
+			for (; i + 8 <= name.size(); i += 8) {
+				uint64_t word;
+				std::memcpy(&word, data + i, 8);
+				bits |= word;
+			}
+			for (; i < name.size(); i++) {
+				bits |= (unsigned char)data[i];
+			}
+			return (bits & 0x8080808080808080ull) == 0;
+		}
+
+		// compare `a` with the (already lowercase) `lower`, ignoring the case of ASCII letters.
+		bool equal_folded(const char *a, std::string_view lower) noexcept {
+			for (std::size_t i = 0; i < lower.size(); i++) {
+				if (ascii_lower[(unsigned char)a[i]] != (unsigned char)lower[i])
+					return false;
+			}
+			return true;
+		}
+
+		// `contains_literal()` for case-insensitive matchers: `needle` is lowercase. ASCII letters are compared with their 0x20 bit
+		// set, which maps both cases onto the lowercase one; the candidates are verified with `equal_folded()`.
+		bool contains_literal_folded(std::string_view haystack, std::string_view needle) noexcept {
+			const std::size_t k = needle.size();
+			if (k == 0)
+				return true;
+			if (haystack.size() < k)
+				return false;
+
+			std::size_t i = 0;
+			const char *data = haystack.data();
+			const char first_case = is_ascii_letter(needle[0]) ? 0x20 : 0;
+			const char last_case = is_ascii_letter(needle[k - 1]) ? 0x20 : 0;
+#if defined(GLOB_SIMD_AVX2)
+			const __m256i first = _mm256_set1_epi8(needle[0]);
+			const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+			const __m256i first_fold = _mm256_set1_epi8(first_case);
+			const __m256i last_fold = _mm256_set1_epi8(last_case);
+			for (; i + k - 1 + 32 <= haystack.size(); i += 32) {
+				const __m256i block_first = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)), first_fold);
+				const __m256i block_last = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + k - 1)), last_fold);
+				uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+				while (mask) {
+					if (equal_folded(data + i + std::countr_zero(mask), needle))
+						return true;
+					mask &= mask - 1;
+				}
+			}
+#elif defined(GLOB_SIMD_SSE2)
+			const __m128i first = _mm_set1_epi8(needle[0]);
+			const __m128i last = _mm_set1_epi8(needle[k - 1]);
+			const __m128i first_fold = _mm_set1_epi8(first_case);
+			const __m128i last_fold = _mm_set1_epi8(last_case);
+			for (; i + k - 1 + 16 <= haystack.size(); i += 16) {
+				const __m128i block_first = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), first_fold);
+				const __m128i block_last = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + k - 1)), last_fold);
+				uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+				while (mask) {
+					if (equal_folded(data + i + std::countr_zero(mask), needle))
 						return true;
+					mask &= mask - 1;
+				}
+			}
+#endif
+			for (; i + k <= haystack.size(); i++) {
+				if ((char)(data[i] | first_case) == needle[0] && equal_folded(data + i, needle))
+					return true;
+			}
+			return false;
+		}
+
+		// Unicode simple case folding (CaseFolding.txt, status C and S) for the scripts which have case and are commonly
+		// found in file names: Latin (incl. Latin-1, Extended-A and Extended Additional), Greek, Cyrillic, Armenian and the
+		// fullwidth Latin letters. Other code points are returned as is.
+		char32_t simple_case_fold(char32_t c) noexcept {
+			if (c < 0x80)
+				return (c >= 'A' && c <= 'Z') ? c + 0x20 : c;
+			if (c < 0x100) {
+				if (c == 0xB5)
+					return 0x3BC;																// MICRO SIGN
+				return (c >= 0xC0 && c <= 0xDE && c != 0xD7) ? c + 0x20 : c;
+			}
+			if (c < 0x180) {
+				if (c == 0x178)
+					return 0xFF;																// Y WITH DIAERESIS
+				if (c == 0x17F)
+					return 's';																	// LONG S
+				if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E))
+					return (c & 1) ? c + 1 : c;
+				if (c < 0x138 && c != 0x130 && c != 0x131)
+					return (c & 1) ? c : c + 1;
+				if (c >= 0x14A && c <= 0x177)
+					return (c & 1) ? c : c + 1;
+				return c;
+			}
+			if (c >= 0x370 && c < 0x400) {
+				if (c == 0x386)
+					return 0x3AC;
+				if (c >= 0x388 && c <= 0x38A)
+					return c + 37;
+				if (c == 0x38C)
+					return 0x3CC;
+				if (c == 0x38E || c == 0x38F)
+					return c + 63;
+				if ((c >= 0x391 && c <= 0x3A1) || (c >= 0x3A3 && c <= 0x3AB))
+					return c + 32;
+				if (c == 0x3C2)
+					return 0x3C3;																// FINAL SIGMA
+				return c;
+			}
+			if (c >= 0x400 && c < 0x530) {
+				if (c < 0x410)
+					return c + 80;
+				if (c < 0x430)
+					return c + 32;
+				if (c == 0x4C0)
+					return 0x4CF;
+				if (c >= 0x4C1 && c <= 0x4CE)
+					return (c & 1) ? c + 1 : c;
+				if ((c >= 0x460 && c <= 0x481) || (c >= 0x48A && c <= 0x4BF) || (c >= 0x4D0 && c <= 0x52F))
+					return (c & 1) ? c : c + 1;
+				return c;
+			}
+			if (c >= 0x531 && c <= 0x556)
+				return c + 48;																	// Armenian
+			if (c >= 0x1E00 && c <= 0x1EFF) {
+				if (c == 0x1E9E)
+					return 0xDF;																// CAPITAL SHARP S
+				if (c <= 0x1E95 || c >= 0x1EA0)
+					return (c & 1) ? c : c + 1;
+				return c;
+			}
+			if (c == 0x2126)
+				return 0x3C9;																		// OHM SIGN
+			if (c == 0x212A)
+				return 'k';																			// KELVIN SIGN
+			if (c == 0x212B)
+				return 0xE5;																		// ANGSTROM SIGN
+			if (c >= 0xFF21 && c <= 0xFF3A)
+				return c + 32;																	// fullwidth A-Z
+			return c;
+		}
+
+		// Case fold the UTF-8 encoded `text` into `out`. Bytes which are not part of a valid UTF-8 sequence are copied unchanged.
+		void fold_utf8(std::string_view text, std::string &out) {
+			out.clear();
+			out.reserve(text.size());
+			std::size_t i = 0;
+			const std::size_t n = text.size();
+			while (i < n) {
+				const unsigned char c = text[i];
+				if (c < 0x80) {
+					out += (char)ascii_lower[c];
+					i++;
+					continue;
+				}
+
+				int len = (c >= 0xF0 && c < 0xF5) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC2 && c < 0xE0) ? 2 : 0;
+				if (c >= 0xF5)
+					len = 0;
+				char32_t cp = (len == 2 ? c & 0x1F : len == 3 ? c & 0x0F : c & 0x07);
+				for (int k = 1; k < len; k++) {
+					if (i + k >= n || ((unsigned char)text[i + k] & 0xC0) != 0x80) {
+						len = 0;
+						break;
 					}
-				} 
+					cp = (cp << 6) | ((unsigned char)text[i + k] & 0x3F);
+				}
+				// reject overlong and surrogate encodings.
+				if (len == 3 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF)))
+					len = 0;
+				if (len == 4 && (cp < 0x10000 || cp > 0x10FFFF))
+					len = 0;
+				if (len == 0) {
+					out += (char)c;
+					i++;
+					continue;
+				}
+
+				const char32_t folded = simple_case_fold(cp);
+				if (folded < 0x80) {
+					out += (char)folded;
+				}
+				else if (folded < 0x800) {
+					out += (char)(0xC0 | (folded >> 6));
+					out += (char)(0x80 | (folded & 0x3F));
+				}
+				else if (folded < 0x10000) {
+					out += (char)(0xE0 | (folded >> 12));
+					out += (char)(0x80 | ((folded >> 6) & 0x3F));
+					out += (char)(0x80 | (folded & 0x3F));
+				}
 				else {
-					assert(!pathspec.deep_spec.empty());
-					assert(has_magic(pathspec.deep_spec));
+					out += (char)(0xF0 | (folded >> 18));
+					out += (char)(0x80 | ((folded >> 12) & 0x3F));
+					out += (char)(0x80 | ((folded >> 6) & 0x3F));
+					out += (char)(0x80 | (folded & 0x3F));
+				}
+				i += len;
+			}
+		}
 
-					fs::path basepath = pathspec.basepath;
+		// case-insensitive matchers: a set of the case folded pattern accepts the uppercase ASCII letters whose lowercase form it accepts.
+		void fold_set(std::array<uint64_t, 4> &set) noexcept {
+			for (unsigned c = 'A'; c <= 'Z'; c++) {
+				if (set_has(set, (unsigned char)(c + 0x20)))
+					set_add(set, (unsigned char)c);
+				else
+					set[c >> 6] &= ~(uint64_t(1) << (c & 63));
+			}
+		}
 
-					for (auto it = pathspec.deep_spec.begin(); /* it != pathspec.deep_spec.end() */; ++it) {
-						fs::path elem = *it;
-						if (!has_magic(elem)) {
-							basepath /= elem;
-							pathspec.basepath_exists = false;
-							continue;
-						}
+		// \return the literal character matched by `set`: its only member or, for case-insensitive matchers, the lowercase
+		// letter when the set is exactly {lowercase, uppercase}. -1 otherwise.
+		int set_literal(const std::array<uint64_t, 4> &set, bool fold_case) noexcept {
+			int c = set_single(set);
+			if (c >= 0 || !fold_case)
+				return c;
+			// both cases of an ASCII letter live in the same 64-bit word (0x40-0x7F)
+			if (set[0] || set[2] || set[3] || std::popcount(set[1]) != 2)
+				return -1;
+			const int lower = 64 + 63 - std::countl_zero(set[1]);
+			const int upper = 64 + std::countr_zero(set[1]);
+			return (lower >= 'a' && lower <= 'z' && upper == lower - 0x20) ? lower : -1;
+		}
 
-						bool recursive_scan_dirtree = is_recursive(elem);
+		// Parse the `[...]` set starting at `pattern[i] == '['`, using the Python fnmatch rules: a leading '!' negates the set,
+		// a ']' directly following the '[' or '[!' is a literal and 'a-z' denotes a range. Backslashes are not special.
+		//
+		// Returns the index just past the closing ']', or 0 when the set is not terminated, in which case the '[' is a literal.
+		std::size_t parse_set(std::string_view pattern, std::size_t i, std::array<uint64_t, 4> &set) {
+			std::size_t n = pattern.size();
+			std::size_t j = i + 1;
+			bool negate = false;
+			if (j < n && pattern[j] == '!') {
+				negate = true;
+				j += 1;
+			}
+			std::size_t start = j;
+			if (j < n && pattern[j] == ']') {
+				j += 1;
+			}
+			while (j < n && pattern[j] != ']') {
+				j += 1;
+			}
+			if (j >= n) {
+				return 0;
+			}
 
-						fs::path sub_spec;
-						for (it++; it != pathspec.deep_spec.end(); ++it) {
-							sub_spec /= *it;
-						}
+			set = {};
+			for (std::size_t k = start; k < j; ) {
+				unsigned char lo = pattern[k];
+				if (k + 2 < j && pattern[k + 1] == '-') {
+					unsigned char hi = pattern[k + 2];
+					for (unsigned c = lo; c <= hi; c++) {
+						set_add(set, (unsigned char)c);
+					}
+					k += 3;
+				}
+				else {
+					set_add(set, lo);
+					k += 1;
+				}
+			}
+			if (negate) {
+				for (auto &word : set) {
+					word = ~word;
+				}
+			}
+			return j + 1;
+		}
 
-						if (!pathspec.basepath_exists)
-						{
-							bool base_exists = fs::exists(basepath);
-							if (!base_exists)
-								return true;
-						}
+	} // namespace end
 
-						// are we processing a '**' wildcard? If we do, we MAY also match empty/NIL, i.e. '**' matching exactly *nothing*:
-						// that's what we deal with right now.
-						if (recursive_scan_dirtree) {
-							fs::directory_entry entry(basepath);
-							bool is_dir = entry.is_directory();
-
-							if (is_dir)
-								cache.dir_count_scanned++;
-							else
-								cache.item_count_scanned++;
-
-							options::filter_info_t fi{
-								.basepath = basepath,
-								.item_relpath = "",
-								.entry = entry,
-
-								.matching_wildcarded_fragment = elem,
-								.subsearch_spec = sub_spec,
-
-								.fragment_is_wildcarded = true,
-								.fragment_is_double_star = true,
-
-								//.userland_may_override_accept = true,
-								.userland_may_override_recurse_into = is_dir,
-
-								.is_directory = is_dir,
-								.is_hidden = is_hidden(basepath),
-
-								.depth = pathspec.actual_depth,
-								.max_recursion_depth = pathspec.max_recursion_depth,
-
-								.item_count_scanned = cache.item_count_scanned,
-								.dir_count_scanned = cache.dir_count_scanned,
-
-								.original_search_spec_index = pathspec.original_spec_index,
-								.actual_search_spec_index = cache.searchpath_index,
-								.search_spec_count = (int)cache.searchpaths.size(),
-							};
-							// Note: patterns ending with a slash should match only directories.
-							options::filter_state_t fs{
-								.accept = (search_spec.include_hidden_entries || !fi.is_hidden) &&
-													sub_spec.empty() &&
-													(is_dir ? search_spec.include_matching_directories : search_spec.include_matching_files && !pathspec.accepts_directories_only /* && fs::exists(basepath) */),
-								.recurse_into = is_dir,
-								.stop_scan_for_this_spec = false,
-								.do_report_progress = false,
-							};
-							fs = search_spec.filter(basepath, fs, fi);
-
-							if (fs.accept) {
-								cache.result_set.push_back(basepath);
-							}
+	// extglob patterns are compiled into a regular expression over bytes, from which a DFA is derived: its states are the
+	// (Brzozowski) derivatives of the expression, i.e. what remains to be matched after a prefix of the name. The terms are
+	// hash-consed and kept in a normal form, so equivalent derivatives are recognized as the same state and the DFA stays small.
+	// Complement is just another term, hence `!(..)` costs no more than `@(..)`.
+	struct wildcard_matcher::automaton {
+		struct term {
+			enum kind_t {
+				empty,					// matches nothing
+				epsilon,				// matches the empty string
+				set,						// a single byte out of `sets[a]`
+				concat,					// `a` followed by `b`
+				alternatives,		// any of `items`
+				star,						// zero or more times `a`
+				complement,			// anything `a` does not match
+			};
+
+			kind_t kind;
+			int a;
+			int b;
+			std::vector<int> items;		// sorted
+			bool nullable;						// matches the empty string
+		};
 
-							if (fs.recurse_into && is_dir) {
-								if (!sub_spec.empty()) {
-									// this effectively drops the '**' from the search path...
-									searchspec spec{
-										.basepath = basepath,
-										.deep_spec = sub_spec,
-										.accepts_directories_only = pathspec.accepts_directories_only,
-										.basepath_exists = true,
-										.actual_depth = pathspec.actual_depth,
-										.max_recursion_depth = pathspec.max_recursion_depth,
-										.original_spec_index = pathspec.original_spec_index,
-									};
-									cache.searchpaths.push_back(spec);
-								} 
-								else {
-									// when there's no further (possibly wildcarded) search spec following the '**', then we assume it is '/*', i.e.
-									//    /bla/**
-									// is assumed identical to
-									//    /bla/**/*
-									searchspec spec{
-										.basepath = basepath,
-										.deep_spec = (sub_spec.empty() ? "*" : sub_spec),
-										.accepts_directories_only = pathspec.accepts_directories_only,
-										.basepath_exists = true,
-										.actual_depth = pathspec.actual_depth,
-										.max_recursion_depth = pathspec.max_recursion_depth,
-										.original_spec_index = pathspec.original_spec_index,
-									};
-									cache.searchpaths.push_back(spec);
-								}
-							}
+		struct term_store {
+			static constexpr int none = 0;			// the `empty` term
+			static constexpr int eps = 1;				// the `epsilon` term
+
+			std::vector<term> terms;
+			std::map<std::vector<int>, int> interned;
+			std::vector<std::array<uint64_t, 4>> sets;
+			std::map<std::array<uint64_t, 4>, int> set_index;
+			std::unordered_map<uint64_t, int> derivatives;		// (term << 8 | byte) -> derivative
+
+			int any = -1;			// '?'
+			int all = -1;			// '*'
+
+			term_store() {
+				intern(term{term::empty, -1, -1, {}, false});
+				intern(term{term::epsilon, -1, -1, {}, true});
+				std::array<uint64_t, 4> full;
+				full.fill(~uint64_t(0));
+				any = make_set(full);
+				all = make_star(any);
+			}
+
+			int intern(term t) {
+				std::vector<int> key{(int)t.kind, t.a, t.b};
+				key.insert(key.end(), t.items.begin(), t.items.end());
+				auto [it, inserted] = interned.emplace(std::move(key), (int)terms.size());
+				if (inserted)
+					terms.push_back(std::move(t));
+				return it->second;
+			}
+
+			int make_set(const std::array<uint64_t, 4> &set) {
+				if (set == std::array<uint64_t, 4>{})
+					return none;
+				auto [it, inserted] = set_index.emplace(set, (int)sets.size());
+				if (inserted)
+					sets.push_back(set);
+				return intern(term{term::set, it->second, -1, {}, false});
+			}
+
+			int make_concat(int a, int b) {
+				if (a == none || b == none)
+					return none;
+				if (a == eps)
+					return b;
+				if (b == eps)
+					return a;
+				if (terms[a].kind == term::concat) {
+					const int first = terms[a].a, second = terms[a].b;
+					return make_concat(first, make_concat(second, b));
+				}
+				return intern(term{term::concat, a, b, {}, terms[a].nullable && terms[b].nullable});
+			}
+
+			int make_alternatives(const std::vector<int> &items) {
+				std::vector<int> flat;
+				for (int t : items) {
+					if (t == all)
+						return all;
+					if (terms[t].kind == term::alternatives)
+						flat.insert(flat.end(), terms[t].items.begin(), terms[t].items.end());
+					else if (t != none)
+						flat.push_back(t);
+				}
+				std::sort(flat.begin(), flat.end());
+				flat.erase(std::unique(flat.begin(), flat.end()), flat.end());
+				if (flat.empty())
+					return none;
+				if (flat.size() == 1)
+					return flat[0];
+				const bool nullable = std::any_of(flat.begin(), flat.end(), [this](int t) {
+					return terms[t].nullable;
+				});
+				return intern(term{term::alternatives, -1, -1, std::move(flat), nullable});
+			}
+
+			int make_star(int a) {
+				if (a == none || a == eps)
+					return eps;
+				if (terms[a].kind == term::star)
+					return a;
+				return intern(term{term::star, a, -1, {}, true});
+			}
+
+			int make_complement(int a) {
+				if (terms[a].kind == term::complement)
+					return terms[a].a;
+				if (a == none)
+					return all;
+				if (a == all)
+					return none;
+				return intern(term{term::complement, a, -1, {}, !terms[a].nullable});
+			}
+
+			// \return the term matching the remainders of the strings matched by `t` which start with `c`.
+			int derivative(int t, unsigned char c) {
+				const uint64_t key = (uint64_t(t) << 8) | c;
+				auto it = derivatives.find(key);
+				if (it != derivatives.end())
+					return it->second;
+
+				// `terms` grows while deriving: copy what's needed of `t` first.
+				const term x = terms[t];
+				int result = none;
+				switch (x.kind) {
+				case term::empty:
+				case term::epsilon:
+					break;
+				case term::set:
+					result = (set_has(sets[x.a], c) ? eps : none);
+					break;
+				case term::concat:
+					result = make_concat(derivative(x.a, c), x.b);
+					if (terms[x.a].nullable)
+						result = make_alternatives({result, derivative(x.b, c)});
+					break;
+				case term::alternatives: {
+					std::vector<int> items;
+					items.reserve(x.items.size());
+					for (int item : x.items)
+						items.push_back(derivative(item, c));
+					result = make_alternatives(items);
+					break;
+				}
+				case term::star:
+					result = make_concat(derivative(x.a, c), t);
+					break;
+				case term::complement:
+					result = make_complement(derivative(x.a, c));
+					break;
+				}
+				derivatives.emplace(key, result);
+				return result;
+			}
+		};
+
+		// more states than this are not tabulated; see `match_slow()`.
+		static constexpr std::size_t max_states = 4096;
+
+		// `match_slow()` keeps extending the store of a shared, otherwise immutable, matcher: `slow_lock` serializes that.
+		// `match()` itself only reads `store.all`, which never changes after construction.
+		mutable term_store store;
+		mutable std::mutex slow_lock;
+		std::array<uint8_t, 256> byte_class{};
+		int class_count = 1;
+		std::vector<int> transitions;		// [state * class_count + byte class]: the next state, -1 when not tabulated
+		std::vector<int> state_term;
+		std::vector<bool> accepting;
+
+		static bool is_operator(char c) noexcept {
+			return c == '?' || c == '*' || c == '+' || c == '@' || c == '!';
+		}
 
-							if (fs.do_report_progress) {
-								//.current_path = basepath,
-								if (!search_spec.progress_reporting(fi, fs))
-									return false;
-							}
+		// \return the index of the ')' closing the extglob group which starts with `pattern[open] == '('`, or npos when it is not terminated.
+		static std::size_t group_end(std::string_view pattern, std::size_t open) noexcept {
+			int depth = 0;
+			for (std::size_t i = open + 1; i < pattern.size(); i++) {
+				const char c = pattern[i];
+				if (c == '[') {
+					const std::size_t end = skip_set(pattern, i);
+					if (end != 0)
+						i = end - 1;
+				}
+				else if (is_operator(c) && i + 1 < pattern.size() && pattern[i + 1] == '(') {
+					depth++;
+					i++;
+				}
+				else if (c == ')') {
+					if (depth == 0)
+						return i;
+					depth--;
+				}
+			}
+			return std::string_view::npos;
+		}
 
-							if (fs.stop_scan_for_this_spec) {
-								return true;
-							}
+		static bool is_group(std::string_view pattern, std::size_t i) noexcept {
+			return is_operator(pattern[i]) && i + 1 < pattern.size() && pattern[i + 1] == '(' && group_end(pattern, i + 1) != std::string_view::npos;
+		}
 
-							// now process the "**" element further: scan the current directory for any subdirectories and recurse into them.
-							// Do this recursively as "**" can match multiple levels of path hierarchy.
-								for (auto &&entry : fs::directory_iterator(basepath, fs::directory_options::skip_permission_denied)) {
-									fs::path path = entry.path();
+		static bool has_group(std::string_view pattern) noexcept {
+			for (std::size_t i = 0; i < pattern.size(); i++) {
+				if (pattern[i] == '[') {
+					const std::size_t end = skip_set(pattern, i);
+					if (end != 0)
+						i = end - 1;
+				}
+				else if (is_group(pattern, i)) {
+					return true;
+				}
+			}
+			return false;
+		}
 
-									bool is_dir = entry.is_directory();
+		// Parse the pattern from `pattern[i]` on into a term. Inside a group, stop at the '|' or ')' which ends the alternative.
+		int parse(std::string_view pattern, std::size_t &i, bool in_group, bool fold_case) {
+			std::vector<int> sequence;
+			while (i < pattern.size()) {
+				const char c = pattern[i];
+				if (in_group && (c == '|' || c == ')'))
+					break;
 
-									if (is_dir)
-										cache.dir_count_scanned++;
-									else
-										cache.item_count_scanned++;
+				if (is_group(pattern, i)) {
+					i += 2;
+					std::vector<int> alternatives;
+					for (;;) {
+						alternatives.push_back(parse(pattern, i, true, fold_case));
+						if (pattern[i++] == ')')
+							break;
+					}
+					const int group = store.make_alternatives(alternatives);
+					switch (c) {
+					case '?':
+						sequence.push_back(store.make_alternatives({term_store::eps, group}));
+						break;
+					case '*':
+						sequence.push_back(store.make_star(group));
+						break;
+					case '+':
+						sequence.push_back(store.make_concat(group, store.make_star(group)));
+						break;
+					case '@':
+						sequence.push_back(group);
+						break;
+					default:
+						sequence.push_back(store.make_complement(group));
+						break;
+					}
+					continue;
+				}
 
-									if (!is_dir)
-										continue;
+				if (c == '*') {
+					sequence.push_back(store.all);
+					i++;
+					continue;
+				}
 
-#if DO_DEBUG
-									if (cache.item_count_scanned > 30000)
-										break;
-#endif
+				std::array<uint64_t, 4> set{};
+				if (c == '?') {
+					set.fill(~uint64_t(0));
+					i++;
+				}
+				else if (c == '[') {
+					const std::size_t next = parse_set(pattern, i, set);
+					if (next == 0) {
+						set_add(set, '[');
+						i++;
+					}
+					else {
+						i = next;
+					}
+				}
+				else {
+					set_add(set, c);
+					i++;
+				}
+				if (fold_case)
+					fold_set(set);
+				sequence.push_back(store.make_set(set));
+			}
 
-									options::filter_info_t fi{
-										.basepath = basepath,
-										.item_relpath = mk_relative(path, basepath),
-										.entry = entry,
-
-										.matching_wildcarded_fragment = elem,
-										.subsearch_spec = sub_spec,
-
-										.fragment_is_wildcarded = true,
-										.fragment_is_double_star = true,
-
-										//.userland_may_override_accept = false,
-										.userland_may_override_recurse_into = true,
-
-										.is_directory = true,
-										.is_hidden = is_hidden(basepath),
-
-										.depth = pathspec.actual_depth + 1,
-										.max_recursion_depth = pathspec.max_recursion_depth,
-
-										.item_count_scanned = cache.item_count_scanned,
-										.dir_count_scanned = cache.dir_count_scanned,
-
-										.original_search_spec_index = pathspec.original_spec_index,
-										.actual_search_spec_index = cache.searchpath_index,
-										.search_spec_count = (int)cache.searchpaths.size(),
-									};
-									options::filter_state_t fs{
-										.accept = (search_spec.include_hidden_entries || !fi.is_hidden) &&
-															sub_spec.empty() &&
-															search_spec.include_matching_directories,
-										.recurse_into = true,
-										.stop_scan_for_this_spec = false,
-										.do_report_progress = false,
-									};
-									fs = search_spec.filter(path, fs, fi);
-
-									if (fs.accept) {
-										cache.result_set.push_back(path);
-									}
-
-									// when there's no further (possibly wildcarded) search spec following the '**', then we assume it is '/*', i.e.
-									//    /bla/**
-									// is assumed identical to
-									//    /bla/**/*
-									if (fs.recurse_into && is_dir && pathspec.actual_depth < pathspec.max_recursion_depth) {
-#if 0
-										searchspec spec{
-											.basepath = path,
-											.deep_spec = (sub_spec.empty() ? "*" : sub_spec),
-											.accepts_directories_only = pathspec.accepts_directories_only,
-											.basepath_exists = true,
-											.actual_depth = pathspec.actual_depth + 1,
-											.max_recursion_depth = pathspec.max_recursion_depth,
-											.original_spec_index = pathspec.original_spec_index,
-										};
-										cache.searchpaths.push_back(spec);
-#endif
+			int result = term_store::eps;
+			for (auto it = sequence.rbegin(); it != sequence.rend(); ++it) {
+				result = store.make_concat(*it, result);
+			}
+			return result;
+		}
 
-										// also queue another level of "**" scanning in this subdirectory...
-										searchspec spec{
-											.basepath = path,
-											.deep_spec = elem / (sub_spec.empty() ? "*" : sub_spec),
-											.accepts_directories_only = pathspec.accepts_directories_only,
-											.basepath_exists = true,
-											.actual_depth = pathspec.actual_depth + 1,
-											.max_recursion_depth = pathspec.max_recursion_depth,
-											.original_spec_index = pathspec.original_spec_index,
-										};
-										cache.searchpaths.push_back(spec);
-									}
-
-									if (fs.do_report_progress) {
-										//.current_path = path,
-										if (!search_spec.progress_reporting(fi, fs))
-											return false;
-									}
-
-									if (fs.stop_scan_for_this_spec) {
-										return true;
-									}
-								}
-						} 
-						else {
-							assert(!recursive_scan_dirtree);
+		void build(int start) {
+			// bytes which no set tells apart behave the same in every state: tabulate the DFA per class of those.
+			std::array<int, 256> classes{};
+			int count = 1;
+			for (const auto &set : store.sets) {
+				std::map<std::pair<int, bool>, int> split;
+				for (unsigned c = 0; c < 256; c++) {
+					auto it = split.emplace(std::make_pair(classes[c], set_has(set, (unsigned char)c)), (int)split.size()).first;
+					classes[c] = it->second;
+				}
+				count = (int)split.size();
+			}
+			std::vector<unsigned char> representative(count);
+			for (int c = 255; c >= 0; c--) {
+				byte_class[c] = (uint8_t)classes[c];
+				representative[classes[c]] = (unsigned char)c;
+			}
+			class_count = count;
+
+			std::unordered_map<int, int> state_of;
+			auto add_state = [&](int t) {
+				const int state = (int)state_term.size();
+				state_of.emplace(t, state);
+				state_term.push_back(t);
+				accepting.push_back(store.terms[t].nullable);
+				transitions.resize(transitions.size() + class_count, -1);
+				return state;
+			};
+
+			add_state(start);
+			for (std::size_t state = 0; state < state_term.size(); state++) {
+				const int t = state_term[state];
+				if (t == term_store::none || t == store.all)
+					continue;
+				for (int k = 0; k < class_count; k++) {
+					const int next = store.derivative(t, representative[k]);
+					auto it = state_of.find(next);
+					if (it != state_of.end())
+						transitions[state * class_count + k] = it->second;
+					else if (state_term.size() < max_states)
+						transitions[state * class_count + k] = add_state(next);
+				}
+			}
+		}
 
-							const auto pattern_re = compile_pattern(elem.string());
+		bool match(std::string_view name) const {
+			int state = 0;
+			for (std::size_t i = 0; i < name.size(); i++) {
+				const int t = state_term[state];
+				// no suffix can change the outcome anymore.
+				if (t == term_store::none)
+					return false;
+				if (t == store.all)
+					return true;
+				const int next = transitions[state * class_count + byte_class[(unsigned char)name[i]]];
+				if (next < 0)
+					return match_slow(t, name.substr(i));
+				state = next;
+			}
+			return accepting[state];
+		}
 
-							// we are NOT processing a '**' wildcard, but a (wildcarded) subspec instead, e.g. "*bla*/reutel.pdf" or "*ska*.mp3"...
-							if (!sub_spec.empty())
-							{
-								// scan wildcarded directory spec element, e.g. "*bla*/" in "*bla*/reutel.pdf", hence we will only accept matching directory names here.
-								for (auto &&entry : fs::directory_iterator(basepath, fs::directory_options::skip_permission_denied)) {
-									fs::path path = entry.path();
+		// beyond `max_states`: continue by deriving the expression on the fly. The derivatives are memoized in the shared store, so
+		// later names reuse them instead of deriving them again.
+		bool match_slow(int t, std::string_view rest) const {
+			std::lock_guard<std::mutex> guard(slow_lock);
+			for (unsigned char c : rest) {
+				t = store.derivative(t, c);
+				if (t == term_store::none)
+					return false;
+			}
+			return store.terms[t].nullable;
+		}
+	};
+
+	wildcard_matcher::wildcard_matcher(std::string_view pattern_text, bool case_insensitive, bool extglob, bool braces)
+		: source(pattern_text),
+		fold_case(case_insensitive),
+		extended(extglob),
+		expand_braces(braces) {
+		// case-insensitive patterns are compiled in folded form, after which every set also accepts the uppercase variants of
+		// its ASCII letters: ASCII names can then be matched as is, only names containing UTF-8 sequences need folding.
+		std::string folded;
+		if (fold_case) {
+			fold_utf8(pattern_text, folded);
+		}
+		const std::string_view pattern = (fold_case ? std::string_view{folded} : pattern_text);
 
-									bool is_dir = entry.is_directory();
+		std::vector<std::string> expansions;
+		if (expand_braces) {
+			glob::expand_braces(pattern, expansions, [](std::string_view, std::size_t, std::size_t) {
+				return true;
+			});
+		}
+		else {
+			expansions.emplace_back(pattern);
+		}
 
-									if (is_dir)
-										cache.dir_count_scanned++;
-									else
-										cache.item_count_scanned++;
+		if (extended && std::any_of(expansions.begin(), expansions.end(), automaton::has_group)) {
+			auto compiled = std::make_shared<automaton>();
+			std::vector<int> alternatives;
+			for (const auto &expansion : expansions) {
+				std::size_t i = 0;
+				alternatives.push_back(compiled->parse(expansion, i, false, fold_case));
+			}
+			compiled->build(compiled->store.make_alternatives(alternatives));
+			dfa = std::move(compiled);
+			return;
+		}
 
-									if (!is_dir)
-										continue;
+		for (const auto &expansion : expansions) {
+			compile_alternative(expansion);
+		}
+		if (alternatives.size() == 1) {
+			trailing_star = alternatives[0].trailing_star;
+			alternatives.clear();
+		}
+		else {
+			trailing_star = false;
+		}
 
-#if DO_DEBUG
-									if (cache.item_count_scanned > 30000)
-										break;
-#endif
+		// one state bit per atom plus a start state per alternative; patterns which need more than 64 states are
+		// walked over several words.
+		const std::size_t m = program.size();
+		const std::size_t count = std::max<std::size_t>(alternatives.size(), 1);
+		state_words = (m + count + 63) / 64;
+		std::vector<uint64_t> start(state_words), star(state_words), accept(state_words), next(256 * state_words);
+		const auto set_bit = [](uint64_t *words, std::size_t bit) {
+			words[bit / 64] |= uint64_t(1) << (bit % 64);
+		};
+		for (std::size_t j = 0; j < count; j++) {
+			const alternative alt = (alternatives.empty() ? alternative{0, m, trailing_star} : alternatives[j]);
+			// alternative J starts at bit `alt.begin + J`: each of the preceding alternatives has an extra (start) state.
+			set_bit(start.data(), alt.begin + j);
+			for (std::size_t k = alt.begin; k < alt.end; k++) {
+				const std::size_t state = k + j + 1;
+				if (program[k].star_before) {
+					set_bit(star.data(), state - 1);
+				}
+				for (unsigned c = 0; c < 256; c++) {
+					if (set_has(program[k].set, (unsigned char)c)) {
+						set_bit(next.data() + c * state_words, state);
+					}
+				}
+			}
+			set_bit(accept.data(), alt.end + j);
+			if (alt.trailing_star) {
+				set_bit(star.data(), alt.end + j);
+			}
+		}
+		if (state_words == 1) {
+			start_states = start[0];
+			star_states = star[0];
+			accept_states = accept[0];
+			std::copy(next.begin(), next.end(), transitions.begin());
+		}
+		else {
+			wide_masks = std::move(start);
+			wide_masks.insert(wide_masks.end(), star.begin(), star.end());
+			wide_masks.insert(wide_masks.end(), accept.begin(), accept.end());
+			wide_masks.insert(wide_masks.end(), next.begin(), next.end());
+		}
 
-									auto relpath = mk_relative(path, basepath);
-									bool fn_match = fnmatch(relpath.string(), pattern_re);
-
-									options::filter_info_t fi{
-										.basepath = basepath,
-										.item_relpath = relpath,
-										.entry = entry,
-
-										.matching_wildcarded_fragment = elem,
-										.subsearch_spec = sub_spec,
-
-										.fragment_is_wildcarded = true,
-										.fragment_is_double_star = false,
-
-										//.userland_may_override_accept = true,
-										.userland_may_override_recurse_into = true,
-
-										.is_directory = true,
-										.is_hidden = is_hidden(path),
-
-										.depth = pathspec.actual_depth + 1,
-										.max_recursion_depth = pathspec.max_recursion_depth,
-
-										.item_count_scanned = cache.item_count_scanned,
-										.dir_count_scanned = cache.dir_count_scanned,
-
-										.original_search_spec_index = pathspec.original_spec_index,
-										.actual_search_spec_index = cache.searchpath_index,
-										.search_spec_count = (int)cache.searchpaths.size(),
-									};
-									options::filter_state_t fs{
-										.accept = false,
-										.recurse_into = fn_match,
-										.stop_scan_for_this_spec = false,
-										.do_report_progress = false,
-									};
-									fs = search_spec.filter(path, fs, fi);
-
-									if (fs.accept) {
-										cache.result_set.push_back(path);
-									}
-
-									if (fs.recurse_into && pathspec.actual_depth < pathspec.max_recursion_depth) {
-										searchspec spec{
-											.basepath = path,
-											.deep_spec = sub_spec,
-											.accepts_directories_only = pathspec.accepts_directories_only,
-											.basepath_exists = true,
-											.actual_depth = pathspec.actual_depth + 1,
-											.max_recursion_depth = pathspec.max_recursion_depth,
-											.original_spec_index = pathspec.original_spec_index,
-										};
-										cache.searchpaths.push_back(spec);
-									}
-
-									if (fs.do_report_progress) {
-										//.current_path = path,
-										if (!search_spec.progress_reporting(fi, fs))
-											return false;
-									}
-
-									if (fs.stop_scan_for_this_spec) {
-										return true;
-									}
-								}
-							} 
-							else {
-								// scan wildcarded filename spec element, e.g. "*ska*.mp3", hence we will accept both matching files and matching directory names here.
-								assert(sub_spec.empty());
+		if (alternatives.empty()) {
+			extract_literals();
+		}
+		else {
+			// brace alternatives: the prefilter can only check what they all have in common.
+			min_length = SIZE_MAX;
+			exact_length = true;
+			for (std::size_t j = 0; j < alternatives.size(); j++) {
+				const alternative &alt = alternatives[j];
+				std::string prefix, suffix;
+				std::size_t k = alt.begin;
+				for (; k < alt.end && !program[k].star_before; k++) {
+					int c = set_literal(program[k].set, fold_case);
+					if (c < 0)
+						break;
+					prefix += (char)c;
+				}
+				if (!alt.trailing_star) {
+					for (std::size_t e = alt.end; e > k; e--) {
+						int c = set_literal(program[e - 1].set, fold_case);
+						if (c < 0)
+							break;
+						suffix.insert(suffix.begin(), (char)c);
+						if (program[e - 1].star_before)
+							break;
+					}
+				}
 
-								for (auto &&entry : fs::directory_iterator(basepath, fs::directory_options::skip_permission_denied)) {
-									fs::path path = entry.path();
+				const std::size_t length = alt.end - alt.begin;
+				const bool exact = !alt.trailing_star && std::none_of(program.begin() + alt.begin, program.begin() + alt.end, [](const atom &a) {
+					return a.star_before;
+				});
+				exact_length = exact_length && exact && (j == 0 || length == min_length);
+				min_length = std::min(min_length, length);
+
+				if (j == 0) {
+					literal_prefix = prefix;
+					literal_suffix = suffix;
+					continue;
+				}
+				std::size_t common = 0;
+				while (common < literal_prefix.size() && common < prefix.size() && literal_prefix[common] == prefix[common])
+					common++;
+				literal_prefix.resize(common);
+				common = 0;
+				while (common < literal_suffix.size() && common < suffix.size() && literal_suffix[literal_suffix.size() - 1 - common] == suffix[suffix.size() - 1 - common])
+					common++;
+				literal_suffix.erase(0, literal_suffix.size() - common);
+			}
+		}
+	}
 
-									bool is_dir = entry.is_directory();
+	// Compile one (brace expanded) alternative of the pattern, appending its atoms to `program`.
+	void wildcard_matcher::compile_alternative(std::string_view pattern) {
+		const std::size_t begin = program.size();
+		std::size_t i = 0, n = pattern.size();
+		bool star = false;
 
-									if (is_dir)
-										cache.dir_count_scanned++;
-									else
-										cache.item_count_scanned++;
+		while (i < n) {
+			auto c = pattern[i];
+			atom a{.set = {}, .star_before = star};
 
-#if DO_DEBUG
-									if (cache.item_count_scanned > 30000)
-										break;
-#endif
+			if (c == '*') {
+				// consecutive stars are equivalent to a single one.
+				star = true;
+				i += 1;
+				continue;
+			}
+			else if (c == '?') {
+				a.set.fill(~uint64_t(0));
+				i += 1;
+			}
+			else if (c == '[') {
+				std::size_t next = parse_set(pattern, i, a.set);
+				if (next == 0) {
+					set_add(a.set, '[');
+					i += 1;
+				}
+				else {
+					i = next;
+				}
+			}
+			else {
+				set_add(a.set, c);
+				i += 1;
+			}
 
-									auto relpath = mk_relative(path, basepath);
-									bool fn_match = fnmatch(relpath.string(), pattern_re);
-
-									options::filter_info_t fi{
-										.basepath = basepath,
-										.item_relpath = relpath,
-										.entry = entry,
-
-										.matching_wildcarded_fragment = elem,
-										.subsearch_spec = "",
-
-										.fragment_is_wildcarded = true,
-										.fragment_is_double_star = false,
-
-										//.userland_may_override_accept = true,
-										.userland_may_override_recurse_into = is_dir,
-
-										.is_directory = is_dir,
-										.is_hidden = is_hidden(path),
-
-										.depth = pathspec.actual_depth,
-										.max_recursion_depth = pathspec.max_recursion_depth,
-
-										.item_count_scanned = cache.item_count_scanned,
-										.dir_count_scanned = cache.dir_count_scanned,
-
-										.original_search_spec_index = pathspec.original_spec_index,
-										.actual_search_spec_index = cache.searchpath_index,
-										.search_spec_count = (int)cache.searchpaths.size(),
-									};
-									options::filter_state_t fs{
-										.accept = (search_spec.include_hidden_entries || !fi.is_hidden) &&
-															(is_dir ? search_spec.include_matching_directories : search_spec.include_matching_files && !pathspec.accepts_directories_only /* && fs::exists(path) */) &&
-															fn_match,
-										.recurse_into = false,
-										.stop_scan_for_this_spec = false,
-										.do_report_progress = false,
-									};
-									fs = search_spec.filter(path, fs, fi);
-
-									if (fs.accept) {
-										cache.result_set.push_back(path);
-									}
-
-									// Note: we do accept a 'recurse_info' override by userland filter here anyway, while the original search spec didn't mandate/suppose that sort of thing.
-									// Userland overrides work both ways...
-									if (fs.recurse_into && is_dir && pathspec.actual_depth < pathspec.max_recursion_depth) {
-										searchspec spec{
-											.basepath = path,
-											.deep_spec = "*",
-											.accepts_directories_only = false,   // we drop this requirement here as the userland override has us going out of original scope already.
-											.basepath_exists = true,
-											.actual_depth = pathspec.actual_depth + 1,
-											.max_recursion_depth = pathspec.max_recursion_depth,
-											.original_spec_index = pathspec.original_spec_index,
-										};
-										cache.searchpaths.push_back(spec);
-									}
-
-									if (fs.do_report_progress) {
-										//.current_path = path,
-										if (!search_spec.progress_reporting(fi, fs))
-											return false;
-									}
-
-									if (fs.stop_scan_for_this_spec) {
-										return true;
-									}
-								}
-							}
-						}
+			if (fold_case) {
+				fold_set(a.set);
+			}
 
-						// all done.
-						break;
-					}
+			program.push_back(a);
+			star = false;
+		}
+		alternatives.push_back(alternative{begin, program.size(), star});
+	}
+
+	// Extract the prefilter literals of a pattern without brace alternatives.
+	void wildcard_matcher::extract_literals() {
+		const std::size_t m = program.size();
+		min_length = m;
+		exact_length = !trailing_star && std::none_of(program.begin(), program.end(), [](const atom &a) {
+			return a.star_before;
+		});
+
+		std::size_t begin = 0;
+		for (; begin < m && !program[begin].star_before; begin++) {
+			int c = set_literal(program[begin].set, fold_case);
+			if (c < 0)
+				break;
+			literal_prefix += (char)c;
+		}
+		std::size_t end = m;
+		if (!trailing_star) {
+			for (; end > begin; end--) {
+				int c = set_literal(program[end - 1].set, fold_case);
+				if (c < 0)
+					break;
+				literal_suffix.insert(literal_suffix.begin(), (char)c);
+				if (program[end - 1].star_before) {
+					end--;
+					break;
 				}
 			}
-			catch (std::exception& ex) {
-				// not a directory
-				// do nothing
-				fs::path searchpath = pathspec.deep_spec / pathspec.deep_spec;
-				auto msg = std::format("{}: {}\n", searchpath.string(), ex.what());
-				cache.error_msg.push_back(msg);
+		}
+
+		// the longest literal run in between: a '*' may only precede its first atom.
+		std::size_t best_pos = 0, best_len = 0;
+		for (std::size_t k = begin; k < end; ) {
+			std::size_t run = k;
+			while (run < end && set_literal(program[run].set, fold_case) >= 0 && (run == k || !program[run].star_before)) {
+				run++;
+			}
+			if (run - k > best_len) {
+				best_pos = k;
+				best_len = run - k;
 			}
+			k = (run == k ? k + 1 : run);
+		}
+		for (std::size_t k = best_pos; k < best_pos + best_len; k++) {
+			literal_infix += (char)set_literal(program[k].set, fold_case);
+		}
 
-			return true;
+		// e.g. "lib*.so", "*.pdf", "*foo*": after the literal checks there's nothing left for the matcher to decide.
+		literals_decide = (literal_prefix.size() + literal_infix.size() + literal_suffix.size() == m);
+	}
+
+	wildcard_matcher::wildcard_matcher(std::string_view pattern, match_function specialized)
+		: source(pattern),
+		specialized(specialized)
+	{}
+
+	bool wildcard_matcher::match(std::string_view name) const noexcept {
+		if (specialized) {
+			return specialized(name);
 		}
+		if (fold_case && !is_ascii(name)) {
+			thread_local std::string folded;
+			fold_utf8(name, folded);
+			return match_folded(folded);
+		}
+		return match_folded(name);
+	}
 
-	} // namespace end
+	// match `name`, which is either case folded already or consists of ASCII characters only when `fold_case` is set.
+	bool wildcard_matcher::match_folded(std::string_view name) const noexcept {
+		if (dfa)
+			return dfa->match(name);
+		if (name.size() < min_length || (exact_length && name.size() != min_length))
+			return false;
+		const std::string_view middle = name.substr(literal_prefix.size(), name.size() - literal_prefix.size() - literal_suffix.size());
+		if (fold_case) {
+			if (!literal_prefix.empty() && !equal_folded(name.data(), literal_prefix))
+				return false;
+			if (!literal_suffix.empty() && !equal_folded(name.data() + name.size() - literal_suffix.size(), literal_suffix))
+				return false;
+			if (!literal_infix.empty() && !contains_literal_folded(middle, literal_infix))
+				return false;
+		}
+		else {
+			if (!literal_prefix.empty() && std::memcmp(name.data(), literal_prefix.data(), literal_prefix.size()) != 0)
+				return false;
+			if (!literal_suffix.empty() && std::memcmp(name.data() + name.size() - literal_suffix.size(), literal_suffix.data(), literal_suffix.size()) != 0)
+				return false;
+			if (!literal_infix.empty() && !contains_literal(middle, literal_infix))
+				return false;
+		}
+		if (literals_decide)
+			return true;
 
+		if (state_words > 1)
+			return match_wide(name);
 
-	//
-	// hotfix because on MS Windows some path' symlinks throw a spanner in the woodworks by being expanded, e.g.
-	//
-	//    fs::relative("C:\\Users\\All Users", "C:\\Users") != "All Users"
-	// 
-	// but returns "..\\ProgramData" instead, and we don't want that, hence we get rid of the implicit weak_canonical() calls
-	// applied to either path:
-	//
-	fs::path mk_relative(const fs::path& p, const fs::path& base) {
-		//return weakly_canonical(p).lexically_relative(weakly_canonical(base));
-		return p.lexically_relative(base);
+		// walk all NFA states in parallel: advance every live state by one atom, while the states
+		// followed by a '*' also stay alive. This is linear in the length of `name`, whatever the pattern.
+		uint64_t states = start_states;
+		for (unsigned char c : name) {
+			states = ((states << 1) & transitions[c]) | (states & star_states);
+			if (!states)
+				return false;
+		}
+		return (states & accept_states) != 0;
 	}
 
-	std::string translate_pattern(std::string_view pattern) {
-		return translate(pattern);
+	// The same NFA walk for patterns with more than 64 states, over `state_words` words per state set: the shift
+	// carries the top bit of each word into the next one. This is O(name * pattern / 64).
+	bool wildcard_matcher::match_wide(std::string_view name) const noexcept {
+		const std::size_t words = state_words;
+		const uint64_t *start = wide_masks.data();
+		const uint64_t *star = start + words;
+		const uint64_t *accept = star + words;
+		const uint64_t *next = accept + words;
+
+		std::array<uint64_t, wide_words_inline> inline_states;
+		std::unique_ptr<uint64_t[]> heap_states;
+		uint64_t *states = inline_states.data();
+		if (words > inline_states.size()) {
+			heap_states.reset(new (std::nothrow) uint64_t[words]);
+			if (!heap_states)
+				return false;
+			states = heap_states.get();
+		}
+		std::copy(start, start + words, states);
+
+		for (unsigned char c : name) {
+			const uint64_t *mask = next + c * words;
+			uint64_t live = 0;
+			// from the top word down, so that word W - 1 still holds the previous states when W is updated.
+			for (std::size_t w = words; w-- > 0;) {
+				const uint64_t carry = (w > 0 ? states[w - 1] >> 63 : 0);
+				states[w] = (((states[w] << 1) | carry) & mask[w]) | (states[w] & star[w]);
+				live |= states[w];
+			}
+			if (!live)
+				return false;
+		}
+		for (std::size_t w = 0; w < words; w++) {
+			if (states[w] & accept[w])
+				return true;
+		}
+		return false;
 	}
 
-	std::regex compile_pattern(std::string_view pattern) {
-		return std::regex(translate(pattern), std::regex::ECMAScript);
+	wildcard_matcher compile_wildcard(std::string_view pattern, bool case_insensitive, bool extglob, bool braces) {
+		return wildcard_matcher(pattern, case_insensitive, extglob, braces);
 	}
 
-	bool fnmatch(std::string&& name, const std::regex& pattern) {
-		return std::regex_match(std::move(name), pattern);
+	bool fnmatch(std::string_view name, const wildcard_matcher& pattern) noexcept {
+		return pattern.match(name);
 	}
 
 	std::vector<fs::path> filter(const std::vector<fs::path> &names,
-															 std::string_view pattern) {
+															 std::string_view pattern, match_flags flags) {
 		// std::cout << "Pattern: " << pattern << "\n";
-		const auto pattern_re = compile_pattern(pattern);
+		const auto matcher = compile_wildcard(pattern, has_flag(flags, match_flags::case_insensitive), has_flag(flags, match_flags::extglob),
+																					has_flag(flags, match_flags::brace_expansion));
 		std::vector<fs::path> result;
 		std::copy_if(std::make_move_iterator(names.begin()), std::make_move_iterator(names.end()),
 								 std::back_inserter(result),
-								 [&pattern_re](const fs::path& name) {
+								 [&matcher](const fs::path& name) {
 								 // std::cout << "Checking for " << name.string() << "\n";
-								 return fnmatch(name.string(), pattern_re);
+								 return fnmatch(name.string(), matcher);
 					 });
 		return result;
 	}
@@ -1050,8 +4572,8 @@ namespace glob {
 	/// Pathnames can be absolute (/usr/src/Foo/Makefile) or relative (../../Tools/*/*.gif)
 	/// Pathnames can contain shell-style wildcards
 	/// Broken symlinks are included in the results (as in the shell)
-	std::vector<fs::path> glob(const std::string &pathname) {
-		return glob(pathname, false);
+	std::vector<fs::path> glob(const std::string &pathname, match_flags flags) {
+		return glob(pathname, false, false, flags);
 	}
 
 	/// \param basepath the root directory to run in
@@ -1061,8 +4583,8 @@ namespace glob {
 	/// Pathnames can be absolute (/usr/src/Foo/Makefile) or relative (../../Tools/*/*.gif)
 	/// Pathnames can contain shell-style wildcards
 	/// Broken symlinks are included in the results (as in the shell)
-	std::vector<fs::path> glob_path(const std::string& basepath, const std::string& pathname) {
-		return glob(fs::path(basepath) / pathname, false);
+	std::vector<fs::path> glob_path(const std::string& basepath, const std::string& pathname, match_flags flags) {
+		return glob(fs::path(basepath) / pathname, false, false, flags);
 	}
 
 	/// \param pathnames string containing a path specification
@@ -1071,8 +4593,8 @@ namespace glob {
 	/// Globs recursively.
 	/// The pattern “**” will match any files and zero or more directories, subdirectories and
 	/// symbolic links to directories.
-	std::vector<fs::path> rglob(const std::string &pathname) {
-		return glob(pathname, true);
+	std::vector<fs::path> rglob(const std::string &pathname, match_flags flags) {
+		return glob(pathname, true, false, flags);
 	}
 
 	/// \param basepath the root directory to run in
@@ -1082,77 +4604,110 @@ namespace glob {
 	/// Globs recursively.
 	/// The pattern “**” will match any files and zero or more directories, subdirectories and
 	/// symbolic links to directories.
-	std::vector<fs::path> rglob_path(const std::string& basepath, const std::string& pathname) {
-		return glob(fs::path(basepath) / pathname, true);
+	std::vector<fs::path> rglob_path(const std::string& basepath, const std::string& pathname, match_flags flags) {
+		return glob(fs::path(basepath) / pathname, true, false, flags);
 	}
 
 
-	/// Runs `glob` against each pathname in `pathnames` and accumulates the results
-	std::vector<fs::path> glob(const std::vector<std::string> &pathnames) {
-		std::vector<fs::path> result;
-		for (const auto &pathname : pathnames) {
-			auto matched_res = glob(pathname, false);
-			std::copy(std::make_move_iterator(matched_res.begin()), std::make_move_iterator(matched_res.end()), std::back_inserter(result));
+	namespace {
+
+		// Append the `matches` of one of several pathnames to `result`. With `match_flags::deduplicate`, the matches an earlier
+		// pathname already produced are dropped.
+		void append_matches(std::vector<fs::path> &result, std::vector<fs::path> &&matches, match_flags flags, reported_results &reported) {
+			for (auto &match : matches) {
+				if (has_flag(flags, match_flags::deduplicate) && !reported.insert(reported_results::string_view_type(match.lexically_normal().native())))
+					continue;
+				result.push_back(std::move(match));
+			}
 		}
-		return result;
+
+		// Runs `glob()` for each of `pathspecs` in turn, sharing their directory listings. Once a pathname has been processed,
+		// the listings the remaining ones cannot use are evicted, so the cache holds no more than the directories still of interest.
+		std::vector<fs::path> glob_pathnames(const std::vector<fs::path> &pathspecs, bool recursive, match_flags flags) {
+			std::vector<std::vector<fs::path>> roots;
+			for (const auto &pathspec : pathspecs) {
+				roots.push_back(listing_roots(pathspec, flags));
+			}
+
+			std::vector<fs::path> result;
+			listing_cache cache;
+			reported_results reported;
+			std::vector<fs::path> remaining_roots;
+			for (std::size_t i = 0; i < pathspecs.size(); i++) {
+				append_matches(result, glob(pathspecs[i], recursive, false, flags, &cache), flags, reported);
+				if (i + 1 == pathspecs.size())
+					break;
+
+				remaining_roots.clear();
+				for (std::size_t j = i + 1; j < pathspecs.size(); j++) {
+					remaining_roots.insert(remaining_roots.end(), roots[j].begin(), roots[j].end());
+				}
+				// nothing to evict when the remaining pathnames cover all the directories this one may have listed.
+				const bool covered = std::all_of(roots[i].begin(), roots[i].end(), [&remaining_roots](const fs::path &root) {
+					return std::any_of(remaining_roots.begin(), remaining_roots.end(), [&root](const fs::path &other) {
+						return is_within(other, root);
+					});
+				});
+				if (!covered) {
+					evict_listings(cache, remaining_roots);
+				}
+			}
+			return result;
+		}
+
+	} // namespace end
+
+	/// Runs `glob` against each pathname in `pathnames` and accumulates the results
+	std::vector<fs::path> glob(const std::vector<std::string> &pathnames, match_flags flags) {
+		return glob_pathnames(std::vector<fs::path>(pathnames.begin(), pathnames.end()), false, flags);
 	}
 
 	/// Runs `glob` against each pathname in `pathnames` and accumulates the results
-	std::vector<fs::path> glob_path(const std::string& basepath, const std::vector<std::string>& pathnames) {
-		std::vector<fs::path> result;
+	std::vector<fs::path> glob_path(const std::string& basepath, const std::vector<std::string>& pathnames, match_flags flags) {
+		std::vector<fs::path> pathspecs;
 		for (auto& pathname : pathnames)
 		{
-			for (auto& match : glob(fs::path(basepath) / pathname, false))
-			{
-				result.push_back(std::move(match));
-			}
+			pathspecs.push_back(fs::path(basepath) / pathname);
 		}
-		return result;
+		return glob_pathnames(pathspecs, false, flags);
 	}
 
 	/// Runs `rglob` against each pathname in `pathnames` and accumulates the results
-	std::vector<fs::path> rglob(const std::vector<std::string> &pathnames) {
-		std::vector<fs::path> result;
-		for (const auto &pathname : pathnames) {
-			auto matched_res = glob(pathname, true);
-			std::copy(std::make_move_iterator(matched_res.begin()), std::make_move_iterator(matched_res.end()), std::back_inserter(result));
-		}
-		return result;
+	std::vector<fs::path> rglob(const std::vector<std::string> &pathnames, match_flags flags) {
+		return glob_pathnames(std::vector<fs::path>(pathnames.begin(), pathnames.end()), true, flags);
 	}
 
 	/// Runs `rglob` against each pathname in `pathnames` and accumulates the results
-	std::vector<fs::path> rglob_path(const std::string& basepath, const std::vector<std::string>& pathnames) {
-		std::vector<fs::path> result;
+	std::vector<fs::path> rglob_path(const std::string& basepath, const std::vector<std::string>& pathnames, match_flags flags) {
+		std::vector<fs::path> pathspecs;
 		for (auto &pathname : pathnames) {
-			for (auto &match : glob(fs::path(basepath) / pathname, true)) {
-				result.push_back(std::move(match));
-			}
+			pathspecs.push_back(fs::path(basepath) / pathname);
 		}
-		return result;
+		return glob_pathnames(pathspecs, true, flags);
 	}
 
 
 	/// Initializer list overload for convenience
-	std::vector<fs::path> glob(const std::initializer_list<std::string> &pathnames) {
-		return glob(std::vector<std::string>(pathnames));
+	std::vector<fs::path> glob(const std::initializer_list<std::string> &pathnames, match_flags flags) {
+		return glob(std::vector<std::string>(pathnames), flags);
 	}
 
 
 	/// Initializer list overload for convenience
-	std::vector<fs::path> glob_path(const std::string& basepath, const std::initializer_list<std::string>& pathnames) {
-		return glob_path(basepath, std::vector<std::string>(pathnames));
+	std::vector<fs::path> glob_path(const std::string& basepath, const std::initializer_list<std::string>& pathnames, match_flags flags) {
+		return glob_path(basepath, std::vector<std::string>(pathnames), flags);
 	}
 
 
 	/// Initializer list overload for convenience
-	std::vector<fs::path> rglob(const std::initializer_list<std::string> &pathnames) {
-		return rglob(std::vector<std::string>(pathnames));
+	std::vector<fs::path> rglob(const std::initializer_list<std::string> &pathnames, match_flags flags) {
+		return rglob(std::vector<std::string>(pathnames), flags);
 	}
 
 
 	/// Initializer list overload for convenience
-	std::vector<fs::path> rglob_path(const std::string& basepath, const std::initializer_list<std::string>& pathnames) {
-		return rglob_path(basepath, std::vector<std::string>(pathnames));
+	std::vector<fs::path> rglob_path(const std::string& basepath, const std::initializer_list<std::string>& pathnames, match_flags flags) {
+		return rglob_path(basepath, std::vector<std::string>(pathnames), flags);
 	}
 
 
@@ -1163,12 +4718,234 @@ namespace glob {
 
 	std::vector<fs::path> glob(options &search_spec) {
 		cached_options cache;
+		prepare_search(cache, search_spec);
+		return run_search(cache, search_spec);
+	}
+
+	void glob(options &search_spec, path_arena &results) {
+		cached_options cache;
+		// sorted results are collected apart from whatever `results` already holds.
+		path_arena found;
+		cache.arena = (sorts_results(search_spec.ordering) ? &found : &results);
+		prepare_search(cache, search_spec);
+		run_search(cache, search_spec);
+		for (auto path : found) {
+			results.push_back(path);
+		}
+	}
+
+	void glob(options &search_spec, path_tree &results) {
+		cached_options cache;
+		// sorted results are collected in an arena first: a tree lists its paths in the order they were added.
+		path_arena found;
+		if (sorts_results(search_spec.ordering))
+			cache.arena = &found;
+		else
+			cache.tree = &results;
+		prepare_search(cache, search_spec);
+		run_search(cache, search_spec);
+		for (auto path : found) {
+			results.push_back(fs::path(path));
+		}
+	}
+
+
+	void path_tree::push_back(const fs::path &path) {
+		const string_view_type full(path.native());
+
+		// `full` is split after its last separator: the directory keeps that separator.
+		std::size_t split = full.size();
+		while (split > 0 && !is_separator(full[split - 1]))
+			split--;
+		const string_view_type dir = full.substr(0, split);
+
+		std::size_t directory = no_directory;
+		if (!dir.empty()) {
+			if (last_directory != no_directory && dir == last_directory_text) {
+				directory = last_directory;
+			}
+			else {
+				directory = intern_directory(dir);
+				last_directory = directory;
+				last_directory_text.assign(dir);
+			}
+			directories[directory].entries.push_back(leaves.size());
+		}
+
+		leaves.push_back(leaf{
+			.directory = directory,
+			.begin = text.size(),
+			.length = full.size() - split,
+		});
+		text.append(full.substr(split));
+	}
+
+	// \return the node of `path`, which ends with a separator, e.g. "/srv/data/": that's "data/" below the node of "/srv/".
+	std::size_t path_tree::intern_directory(string_view_type path) {
+		std::size_t split = path.size() - 1;
+		while (split > 0 && !is_separator(path[split - 1]))
+			split--;
+		const std::size_t parent = (split > 0 ? intern_directory(path.substr(0, split)) : no_directory);
+
+		node_key key{parent, string_type(path.substr(split))};
+		auto it = lookup.find(key);
+		if (it != lookup.end())
+			return it->second;
+
+		directories.push_back(directory_node{
+			.parent = parent,
+			.begin = text.size(),
+			.length = path.size() - split,
+		});
+		text.append(path.substr(split));
+		lookup.emplace(std::move(key), directories.size() - 1);
+		return directories.size() - 1;
+	}
+
+	void path_tree::append_directory(string_type &out, std::size_t directory) const {
+		const directory_node &node = directories[directory];
+		if (node.parent != no_directory)
+			append_directory(out, node.parent);
+		out.append(text, node.begin, node.length);
+	}
+
+	fs::path path_tree::path(std::size_t index) const {
+		string_type out;
+		if (leaves[index].directory != no_directory)
+			append_directory(out, leaves[index].directory);
+		out.append(name(index));
+		return fs::path(std::move(out));
+	}
+
+	fs::path path_tree::directory_path(std::size_t directory) const {
+		string_type out;
+		append_directory(out, directory);
+		// drop the separator the directory text ends with, except for a root such as "/".
+		return fs::path(std::move(out)).parent_path();
+	}
+
+	std::vector<fs::path> path_tree::to_paths() const {
+		std::vector<fs::path> paths;
+		paths.reserve(size());
+		for (std::size_t index = 0; index < size(); index++) {
+			paths.push_back(path(index));
+		}
+		return paths;
+	}
+
+	void path_tree::clear() {
+		text.clear();
+		directories.clear();
+		leaves.clear();
+		lookup.clear();
+		last_directory_text.clear();
+		last_directory = no_directory;
+	}
+
+
+	struct prepared_query::state {
+		explicit state(const options &search_spec)
+			: defaults(search_spec)
+		{}
+
+		// the parsed spec programs, their compiled matchers and the initial queue; never modified after preparation.
+		cached_options prepared;
+		options defaults;
+		// `prepared_query(options&)`: the caller's options, whose callbacks `run()` uses.
+		options *source = nullptr;
+	};
+
+	prepared_query::prepared_query(const options &search_specification)
+		: impl(std::make_unique<state>(search_specification))
+	{
+		prepare_search(impl->prepared, impl->defaults);
+	}
+
+	prepared_query::prepared_query(options &search_specification)
+		: impl(std::make_unique<state>(search_specification))
+	{
+		impl->source = &search_specification;
+		prepare_search(impl->prepared, search_specification);
+	}
+
+	prepared_query::~prepared_query() = default;
+	prepared_query::prepared_query(prepared_query &&) noexcept = default;
+	prepared_query &prepared_query::operator=(prepared_query &&) noexcept = default;
+
+	std::vector<fs::path> prepared_query::run(options &search_specification) const {
+		const cached_options &prepared = impl->prepared;
+
+		// the programs keep pointing at the matchers owned by `prepared`, which are only ever read.
+		cached_options cache;
+		cache.basepath = prepared.basepath;
+		cache.programs = prepared.programs;
+		cache.searchpaths = prepared.searchpaths;
+		cache.searchpath_count = prepared.searchpath_count;
+		cache.directories = prepared.directories;
+		cache.default_callbacks = (typeid(search_specification) == typeid(options));
+		cache.copy_info_paths = search_specification.copy_filter_info_paths;
+		cache.dedup = search_specification.deduplicate;
+		cache.merge_specs = prepared.merge_specs;
+		cache.pending = prepared.pending;
+		cache.native_reader = prepared.native_reader;
+		cache.use_io_uring = prepared.use_io_uring;
+
+		return run_search(cache, search_specification);
+	}
+
+	std::vector<fs::path> prepared_query::run() const {
+		if (impl->source)
+			return run(*impl->source);
+		options search_spec(impl->defaults);
+		return run(search_spec);
+	}
+
+
+	struct glob_range::state {
+		explicit state(options &search_spec)
+			: search_spec(search_spec)
+		{}
+
+		options &search_spec;
+		cached_options cache;
+
+		// results handed out so far from `cache.result_set`, which is emptied whenever it has been consumed entirely.
+		std::size_t consumed = 0;
+		bool running = true;
+	};
+
+	glob_range::glob_range(options &search_specification)
+		: impl(std::make_unique<state>(search_specification))
+	{}
+
+	glob_range::~glob_range() = default;
+	glob_range::glob_range(glob_range &&) noexcept = default;
+	glob_range &glob_range::operator=(glob_range &&) noexcept = default;
 
-		while (glob_42(cache, search_spec)) {
-			cache.searchpath_index++;
+	glob_range::iterator glob_range::begin() {
+		if (!started) {
+			started = true;
+			done = !advance();
 		}
+		return done ? end() : iterator(this);
+	}
+
+	bool glob_range::advance() {
+		auto &cache = impl->cache;
+		while (impl->consumed >= cache.result_set.size()) {
+			cache.result_set.clear();
+			impl->consumed = 0;
 
-		return cache.result_set;
+			if (!impl->running) {
+				done = true;
+				return false;
+			}
+			impl->running = glob_42(cache, impl->search_spec);
+			if (impl->running)
+				cache.searchpath_index++;
+		}
+		current = std::move(cache.result_set[impl->consumed++]);
+		return true;
 	}
 
 
@@ -1178,6 +4955,10 @@ namespace glob {
 		return glob_says_pass;
 	}
 
+	// batch filter callback (see `options::use_batch_filter`): the default leaves all of glob's verdicts as they are.
+	void options::filter_batch(const fs::path &basepath, batch_entries_t entries, const filter_info_t &info) {
+	}
+
 	// progress callback: shows currently processed path, pass/reject status and progress/scan completion estimate.
 	// Return `false` to abort the glob action.
 	bool options::progress_reporting(const progress_info_t &info, const filter_state_t state) {
@@ -0,0 +1,873 @@
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <set>
+#include <span>
+#include <string>
+#include <thread>
+
+#include "glob/glob.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A scratch directory tree, removed again when the test is done, also when an `ASSERT_*` bails out early.
+struct temp_tree {
+  temp_tree() {
+    // create_directory() fails for a name which is already taken, e.g. by a concurrently running test binary.
+    static std::random_device entropy;
+    static std::atomic<unsigned> counter{0};
+    do {
+      path = fs::temp_directory_path() /
+             ("glob_test_" + std::to_string(entropy()) + "_" + std::to_string(counter++));
+    } while (!fs::create_directory(path));
+
+    fs::create_directories(path / "src" / "core" / "sub");
+    fs::create_directories(path / "src" / "net");
+    fs::create_directories(path / "docs");
+    for (auto f : {"src/a.cpp", "src/a.h", "src/CMakeLists.txt", "src/core/x.cpp", "src/core/x.h",
+                   "src/core/sub/z.cpp", "src/net/n.cpp", "src/net/CMakeLists.txt", "docs/readme.pdf"}) {
+      std::ofstream(path / f).close();
+    }
+  }
+
+  ~temp_tree() {
+    std::error_code ec;
+    fs::remove_all(path, ec);
+  }
+
+  temp_tree(const temp_tree &) = delete;
+  temp_tree &operator=(const temp_tree &) = delete;
+
+  fs::path path;
+};
+
+std::vector<std::string> sorted_strings(const std::vector<fs::path> &paths) {
+  std::vector<std::string> result;
+  for (auto &p : paths) {
+    result.push_back(p.lexically_normal().generic_string());
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+// records the final (100% done) progress report
+struct counting_options : glob::options {
+  using glob::options::options;
+
+  int items_scanned = 0;
+  int dirs_scanned = 0;
+
+  bool progress_reporting(const progress_info_t &info, const filter_state_t state) override {
+    items_scanned = info.item_count_scanned;
+    dirs_scanned = info.dir_count_scanned;
+    return true;
+  }
+};
+
+}  // namespace
+
+TEST(wildcardMatcherTest, Basics) {
+  EXPECT_TRUE(glob::fnmatch("foo.cpp", glob::compile_wildcard("*.cpp")));
+  EXPECT_FALSE(glob::fnmatch("foo.cpp.bak", glob::compile_wildcard("*.cpp")));
+  EXPECT_TRUE(glob::fnmatch("lib1.so.2", glob::compile_wildcard("lib?.so*")));
+  EXPECT_TRUE(glob::fnmatch("", glob::compile_wildcard("")));
+  EXPECT_TRUE(glob::fnmatch("", glob::compile_wildcard("**")));
+  EXPECT_FALSE(glob::fnmatch("a", glob::compile_wildcard("")));
+}
+
+TEST(wildcardMatcherTest, CharacterSets) {
+  EXPECT_TRUE(glob::fnmatch("ab5", glob::compile_wildcard("ab[1-9]")));
+  EXPECT_FALSE(glob::fnmatch("ab0", glob::compile_wildcard("ab[1-9]")));
+  EXPECT_TRUE(glob::fnmatch("ab0", glob::compile_wildcard("ab[!1-9]")));
+  EXPECT_TRUE(glob::fnmatch("ab^", glob::compile_wildcard("ab[^1-9]")));
+  EXPECT_TRUE(glob::fnmatch("]", glob::compile_wildcard("[]-]")));
+  EXPECT_TRUE(glob::fnmatch("-", glob::compile_wildcard("[a-]")));
+  EXPECT_TRUE(glob::fnmatch("a\\", glob::compile_wildcard("a[[?*\\]")));
+  EXPECT_TRUE(glob::fnmatch("a*", glob::compile_wildcard("a[[?*\\]")));
+  // unterminated sets are literal
+  EXPECT_TRUE(glob::fnmatch("[ab", glob::compile_wildcard("[ab")));
+}
+
+TEST(wildcardMatcherTest, PathologicalPatternIsLinear) {
+  const auto matcher = glob::compile_wildcard("*a*a*a*a*a*a*a*a*a*a*a*a*b");
+  EXPECT_FALSE(matcher.match(std::string(200000, 'a')));
+  EXPECT_TRUE(matcher.match(std::string(200000, 'a') + "b"));
+}
+
+TEST(wildcardMatcherTest, LongPatterns) {
+  std::string name(100, 'x');
+  std::string pattern = "*" + std::string(70, '?') + "*x";
+  EXPECT_TRUE(glob::fnmatch(name, glob::compile_wildcard(pattern)));
+  EXPECT_FALSE(glob::fnmatch(name.substr(0, 70), glob::compile_wildcard(pattern)));
+
+  // more than 64 states: the multi-word walk stays linear in the name as well.
+  std::string stars;
+  for (int i = 0; i < 70; i++)
+    stars += "*a";
+  const auto matcher = glob::compile_wildcard(stars + "b");
+  EXPECT_FALSE(matcher.match(std::string(200000, 'a')));
+  EXPECT_TRUE(matcher.match(std::string(200000, 'a') + "b"));
+  EXPECT_FALSE(matcher.match(std::string(69, 'a') + "b"));
+
+  // states carried across several words, with and without brace alternatives
+  const std::string literal(300, 'y');
+  EXPECT_TRUE(glob::fnmatch(literal, glob::compile_wildcard(literal)));
+  EXPECT_FALSE(glob::fnmatch(literal + "y", glob::compile_wildcard(literal)));
+  const auto alternatives = glob::compile_wildcard("{" + literal + "," + std::string(100, '?') + "z}", false, false, true);
+  EXPECT_TRUE(alternatives.match(literal));
+  EXPECT_TRUE(alternatives.match(std::string(100, 'q') + "z"));
+  EXPECT_FALSE(alternatives.match(std::string(100, 'q')));
+
+  // beyond the inline state buffer
+  const std::string huge = "*" + std::string(2000, '?') + "*";
+  EXPECT_TRUE(glob::fnmatch(std::string(2500, 'x'), glob::compile_wildcard(huge)));
+  EXPECT_FALSE(glob::fnmatch(std::string(1999, 'x'), glob::compile_wildcard(huge)));
+}
+
+TEST(globOptionsTest, MergeOverlappingSpecs) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+  std::vector<std::string> specs{"src/**/*.cpp", "src/**/*.h", "src/**/CMakeLists.txt", "**/*.pdf"};
+
+  counting_options separate(temp_dir, specs);
+  auto expected = glob::glob(separate);
+
+  counting_options merged(temp_dir, specs);
+  merged.merge_overlapping_specs = true;
+  auto matches = glob::glob(merged);
+
+  EXPECT_EQ(sorted_strings(matches), sorted_strings(expected));
+  EXPECT_EQ(matches.size(), 9);
+  EXPECT_LT(merged.items_scanned + merged.dirs_scanned, separate.items_scanned + separate.dirs_scanned);
+}
+
+TEST(globOptionsTest, NativeDirectoryReader) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+  std::vector<std::string> specs{"**/*", "src/*/*.cpp", "src/CMakeLists.txt", "*/core/"};
+
+  glob::options portable(temp_dir, specs);
+  portable.include_matching_directories = true;
+  portable.use_native_directory_reader = false;
+  auto expected = glob::glob(portable);
+
+  glob::options native(temp_dir, specs);
+  native.include_matching_directories = true;
+  native.use_native_directory_reader = true;
+  auto matches = glob::glob(native);
+
+  EXPECT_EQ(sorted_strings(matches), sorted_strings(expected));
+  EXPECT_FALSE(matches.empty());
+}
+
+TEST(globOptionsTest, MultiThreaded) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+  std::vector<std::string> specs{"**/*.cpp", "src/*/CMakeLists.txt", "**/"};
+
+  glob::options single(temp_dir, specs);
+  single.include_matching_directories = true;
+  auto expected = glob::glob(single);
+
+  for (bool merge : {false, true}) {
+    counting_options threaded(temp_dir, specs);
+    threaded.include_matching_directories = true;
+    threaded.merge_overlapping_specs = merge;
+    threaded.thread_count = 4;
+    auto matches = glob::glob(threaded);
+
+    EXPECT_EQ(sorted_strings(matches), sorted_strings(expected));
+    EXPECT_GT(threaded.items_scanned + threaded.dirs_scanned, 0);
+  }
+}
+
+TEST(globOptionsTest, IoUringStatx) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+  fs::create_directory_symlink(temp_dir / "src" / "core", temp_dir / "linked");
+  fs::create_symlink(temp_dir / "missing", temp_dir / "broken");
+  std::vector<std::string> specs{"*/", "*/*.cpp", "*"};
+
+  glob::options plain(temp_dir, specs);
+  plain.include_matching_directories = true;
+  auto expected = glob::glob(plain);
+
+  glob::options batched(temp_dir, specs);
+  batched.include_matching_directories = true;
+  batched.use_native_directory_reader = true;
+  batched.use_io_uring = true;
+  auto matches = glob::glob(batched);
+
+  EXPECT_EQ(sorted_strings(matches), sorted_strings(expected));
+  EXPECT_NE(std::find(matches.begin(), matches.end(), temp_dir / "linked" / "x.cpp"), matches.end());
+
+  // the subdirectories are opened ahead of time, in either traversal order
+  glob::options deep(temp_dir, "**/*.cpp");
+  deep.use_native_directory_reader = true;
+  const auto all_sources = sorted_strings(glob::glob(deep));
+  deep.use_io_uring = true;
+  EXPECT_EQ(sorted_strings(glob::glob(deep)), all_sources);
+  deep.traversal = glob::traversal_order::depth_first;
+  EXPECT_EQ(sorted_strings(glob::glob(deep)), all_sources);
+}
+
+TEST(globRangeTest, YieldsAllMatchesLazily) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  glob::options spec(temp_dir, "**/*.cpp");
+  auto expected = glob::glob(spec);
+
+  std::vector<fs::path> matches;
+  for (const auto &path : glob::glob_range(spec)) {
+    matches.push_back(path);
+  }
+  EXPECT_EQ(sorted_strings(matches), sorted_strings(expected));
+
+  // stopping early only scans part of the tree
+  counting_options counted(temp_dir, "**/*.cpp");
+  {
+    glob::glob_range range(counted);
+    auto it = range.begin();
+    ASSERT_NE(it, range.end());
+    EXPECT_EQ(it->extension(), ".cpp");
+  }
+  EXPECT_EQ(counted.items_scanned, 0);  // the final progress report never happened
+}
+
+TEST(staticPatternTest, SpecializedShapes) {
+  using shape = glob::detail::static_shape;
+  static_assert(glob::static_pattern<"*.json">::match("a.json"));
+  static_assert(!glob::static_pattern<"*.json">::match("a.json5"));
+  static_assert(glob::detail::specialized_matcher<"*.json", 0>::shape.kind == shape::suffix);
+  static_assert(glob::detail::specialized_matcher<"lib*.so", 0>::shape.kind == shape::prefix_suffix);
+  static_assert(glob::detail::specialized_matcher<"**test*", 0>::shape.kind == shape::infix);
+  static_assert(glob::detail::specialized_matcher<"Makefile", 0>::shape.kind == shape::exact);
+  static_assert(glob::detail::specialized_matcher<"a?[!0-9]*", 0>::shape.kind == shape::generic);
+  static_assert(glob::static_pattern<"**/*.proto">::element == "*.proto");
+  static_assert(glob::static_pattern<"**/*.proto">::element_match("x.proto"));
+  static_assert(!glob::detail::is_valid_wildcard("[z-a]"));
+  static_assert(!glob::detail::is_valid_wildcard("a[bc"));
+
+  // the specialized matchers agree with the runtime one
+  const std::vector<std::string> names{"", "a", "a.json", "liba.so", "lib.so", "libso", "xtesty", "test", "ab1", "abx", "a]", "json"};
+#define CHECK_SAME(P)                                                                            \
+  for (const auto &name : names) {                                                               \
+    EXPECT_EQ(glob::static_pattern<P>::match(name), glob::compile_wildcard(P).match(name)) << P << " " << name; \
+  }
+  CHECK_SAME("*.json")
+  CHECK_SAME("lib*.so")
+  CHECK_SAME("*test*")
+  CHECK_SAME("lib*")
+  CHECK_SAME("*")
+  CHECK_SAME("a")
+  CHECK_SAME("a?[!0-9]*")
+  CHECK_SAME("[]a]*")
+  CHECK_SAME("*a*b*")
+#undef CHECK_SAME
+}
+
+TEST(staticPatternTest, GlobAndFilterOverloads) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  auto expected = glob::glob(glob::options(temp_dir, "**/*.cpp"));
+  auto matches = glob::glob(temp_dir, glob::static_pattern<"**/*.cpp">{});
+  EXPECT_EQ(sorted_strings(matches), sorted_strings(expected));
+  EXPECT_EQ(matches.size(), 4);
+
+  std::vector<fs::path> names{"a.cpp", "b.h", "src/c.cpp"};
+  EXPECT_EQ(glob::filter(names, glob::static_pattern<"*.cpp">{}), glob::filter(names, "*.cpp"));
+}
+
+TEST(wildcardMatcherTest, LiteralPrefilter) {
+  const auto infix = glob::compile_wildcard("*needle*");
+  std::string name(100, 'n');
+  EXPECT_FALSE(infix.match(name));
+  for (std::size_t at : {0, 1, 15, 16, 31, 40, 94}) {
+    std::string hit = name;
+    hit.replace(at, 6, "needle");
+    EXPECT_TRUE(infix.match(hit)) << at;
+  }
+
+  EXPECT_TRUE(glob::compile_wildcard("lib*.so*").match("libfoo.so.1"));
+  EXPECT_FALSE(glob::compile_wildcard("lib*.so*").match("libfoo.s"));
+  // the infix must lie in between the prefix and suffix
+  EXPECT_FALSE(glob::compile_wildcard("ab*b*ba").match("aba"));
+  EXPECT_TRUE(glob::compile_wildcard("ab*x*ba").match("abxba"));
+  EXPECT_TRUE(glob::compile_wildcard("a?c").match("abc"));
+  EXPECT_FALSE(glob::compile_wildcard("a?c").match("abbc"));
+}
+
+TEST(wildcardMatcherTest, CaseInsensitive) {
+  const auto pdf = glob::compile_wildcard("*.PDF", true);
+  EXPECT_TRUE(pdf.case_insensitive());
+  EXPECT_TRUE(pdf.match("report.pdf"));
+  EXPECT_TRUE(pdf.match("Report.Pdf"));
+  EXPECT_FALSE(pdf.match("report.pdfx"));
+  EXPECT_FALSE(glob::compile_wildcard("*.PDF").match("report.pdf"));
+
+  EXPECT_TRUE(glob::compile_wildcard("[a-c]?", true).match("Bx"));
+  EXPECT_FALSE(glob::compile_wildcard("[!a]*", true).match("Abc"));
+
+  const auto infix = glob::compile_wildcard("*NeedLe*", true);
+  std::string name(100, 'n');
+  EXPECT_FALSE(infix.match(name));
+  name.replace(40, 6, "nEEDle");
+  EXPECT_TRUE(infix.match(name));
+
+  // UTF-8 names are case folded before matching
+  EXPECT_TRUE(glob::compile_wildcard("\xC3\x84rger*", true).match("\xC3\xA4RGER.txt"));   // Ärger*, ärger.txt
+  EXPECT_FALSE(glob::compile_wildcard("a*", true).match("\xC3\x84"));
+}
+
+TEST(globOptionsTest, CaseInsensitive) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  glob::options spec(temp_dir, std::vector<std::string>{"SRC/*.CPP", "Docs/README.*"});
+  EXPECT_TRUE(glob::glob(spec).empty());
+
+  spec.case_insensitive = true;
+  EXPECT_EQ(sorted_strings(glob::glob(spec)),
+            sorted_strings({temp_dir / "docs/readme.pdf", temp_dir / "src/a.cpp"}));
+
+  EXPECT_EQ(sorted_strings(glob::glob((temp_dir / "SRC/Core/*.H").string(), glob::match_flags::case_insensitive)),
+            sorted_strings({temp_dir / "src/core/x.h"}));
+  EXPECT_EQ(glob::rglob_path(temp_dir.string(), "**/cmakelists.TXT", glob::match_flags::case_insensitive).size(), 2);
+
+  const std::vector<fs::path> names{"A.TXT", "b.txt", "c.md"};
+  EXPECT_EQ(glob::filter(names, "*.txt", glob::match_flags::case_insensitive).size(), 2);
+  EXPECT_EQ(glob::filter(names, "*.txt").size(), 1);
+}
+
+TEST(wildcardMatcherTest, BraceAlternatives) {
+  const auto sources = glob::compile_wildcard("*.{cpp,h,hpp}", false, false, true);
+  EXPECT_TRUE(sources.braces());
+  EXPECT_TRUE(sources.match("a.cpp"));
+  EXPECT_TRUE(sources.match("a.h"));
+  EXPECT_TRUE(sources.match("a.hpp"));
+  EXPECT_FALSE(sources.match("a.c"));
+
+  EXPECT_TRUE(glob::compile_wildcard("x{a,{b,c}d}y", false, false, true).match("xcdy"));
+  EXPECT_FALSE(glob::compile_wildcard("x{a,{b,c}d}y", false, false, true).match("xby"));
+  // no ',' means no alternatives
+  EXPECT_TRUE(glob::compile_wildcard("{a}", false, false, true).match("{a}"));
+  EXPECT_TRUE(glob::compile_wildcard("[{]a,b}", false, false, true).match("{a,b}"));
+
+  // braces are ordinary characters unless enabled
+  const auto literal = glob::compile_wildcard("*.{cpp,h}");
+  EXPECT_FALSE(literal.braces());
+  EXPECT_TRUE(literal.match("a.{cpp,h}"));
+  EXPECT_FALSE(literal.match("a.cpp"));
+}
+
+TEST(wildcardMatcherTest, Extglob) {
+  const auto library = glob::compile_wildcard("lib+([0-9]).so", false, true);
+  EXPECT_TRUE(library.extglob());
+  EXPECT_TRUE(library.match("lib12.so"));
+  EXPECT_FALSE(library.match("lib.so"));
+  EXPECT_FALSE(library.match("libx.so"));
+
+  const auto objects = glob::compile_wildcard("!(*.o|*.a)", false, true);
+  EXPECT_TRUE(objects.match("main.cpp"));
+  EXPECT_TRUE(objects.match("main.o.txt"));
+  EXPECT_FALSE(objects.match("main.o"));
+  EXPECT_FALSE(objects.match("libx.a"));
+
+  EXPECT_TRUE(glob::compile_wildcard("?(x)y", false, true).match("y"));
+  EXPECT_TRUE(glob::compile_wildcard("*(ab|c)d", false, true).match("abcabd"));
+  EXPECT_FALSE(glob::compile_wildcard("*(ab|c)d", false, true).match("abad"));
+  EXPECT_TRUE(glob::compile_wildcard("@(foo|+(b)ar)", false, true).match("bbbar"));
+  EXPECT_TRUE(glob::compile_wildcard("@(README|NEWS).*", true, true).match("readme.md"));
+
+  // without extglob the operators are plain wildcards and literals
+  EXPECT_FALSE(glob::compile_wildcard("@(a|b)").match("a"));
+  EXPECT_TRUE(glob::compile_wildcard("@(a|b)").match("@(a|b)"));
+
+  // no backtracking: a long name which almost matches is rejected in a single pass
+  EXPECT_FALSE(glob::compile_wildcard("*(a|aa|aaa)b", false, true).match(std::string(100000, 'a')));
+
+  // past the state limit one matcher is shared by several threads
+  const auto huge = glob::compile_wildcard("!(*a" + std::string(14, '?') + ")", false, true);
+  std::vector<std::thread> threads;
+  std::atomic<int> mismatches{0};
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&huge, &mismatches, t]() {
+      for (int i = 0; i < 200; ++i) {
+        std::string name(15, 'b');
+        name[(i + t) % 15] = 'a';
+        if (huge.match(name) != ((i + t) % 15 != 0)) {
+          ++mismatches;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(mismatches, 0);
+}
+
+// counts the entries offered to filter() per directory
+struct listing_options : glob::options {
+  using glob::options::options;
+
+  std::map<std::string, int> entries;
+
+  filter_state_t filter(fs::path path, filter_state_t glob_says_pass, const filter_info_t &info) override {
+    if (info.fragment_is_wildcarded && !info.fragment_is_double_star) {
+      entries[info.get_basepath().lexically_normal().generic_string()]++;
+    }
+    return glob_says_pass;
+  }
+};
+
+TEST(globOptionsTest, BraceExpansion) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  listing_options spec(temp_dir, std::vector<std::string>{"src/{core,net}/*.{cpp,h}", "{src,docs}/{a.h,readme.pdf}", "src/{core/sub,net}/*.cpp"});
+  EXPECT_TRUE(glob::glob(spec).empty());
+  spec.brace_expansion = true;
+  spec.entries.clear();
+  EXPECT_EQ(sorted_strings(glob::glob(spec)),
+            sorted_strings({temp_dir / "docs/readme.pdf", temp_dir / "src/a.h", temp_dir / "src/core/sub/z.cpp",
+                            temp_dir / "src/core/x.cpp", temp_dir / "src/core/x.h", temp_dir / "src/net/n.cpp", temp_dir / "src/net/n.cpp"}));
+  // "*.{cpp,h}" is a single matcher: every entry of src/core is looked at once
+  EXPECT_EQ(spec.entries[(temp_dir / "src/core").lexically_normal().generic_string()], 3);
+
+  glob::options recursive(temp_dir, "src/**/{CMakeLists.txt,*.h}");
+  recursive.brace_expansion = true;
+  EXPECT_EQ(glob::glob(recursive).size(), 4);
+
+  EXPECT_EQ(sorted_strings(glob::glob((temp_dir / "{src,docs}/*.{h,pdf}").string(), glob::match_flags::brace_expansion)),
+            sorted_strings({temp_dir / "docs/readme.pdf", temp_dir / "src/a.h"}));
+
+  // by default, braces are part of file names
+  std::ofstream(temp_dir / "docs/{a,b}.txt").close();
+  EXPECT_EQ(glob::glob((temp_dir / "docs/{a,b}.txt").string()), std::vector<fs::path>{temp_dir / "docs/{a,b}.txt"});
+  glob::options literal(temp_dir, std::vector<std::string>{"docs/{a,b}.txt", "docs/*{a,b}*"});
+  EXPECT_EQ(glob::glob(literal), (std::vector<fs::path>{temp_dir / "docs/{a,b}.txt", temp_dir / "docs/{a,b}.txt"}));
+}
+
+TEST(globOptionsTest, Extglob) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  glob::options spec(temp_dir, "src/!(*.h|CMakeLists.txt)");
+  EXPECT_TRUE(glob::glob(spec).empty());
+
+  spec.extglob = true;
+  EXPECT_EQ(sorted_strings(glob::glob(spec)),
+            sorted_strings({temp_dir / "src/a.cpp"}));
+
+  EXPECT_EQ(sorted_strings(glob::glob((temp_dir / "src/@(core|net)/*.cpp").string(), glob::match_flags::extglob)),
+            sorted_strings({temp_dir / "src/core/x.cpp", temp_dir / "src/net/n.cpp"}));
+}
+
+// records the directories in the order they're scanned
+struct traversal_options : glob::options {
+  using glob::options::options;
+
+  std::vector<fs::path> directories;
+  std::set<glob::traversal_order> orders;
+
+  filter_state_t filter(fs::path path, filter_state_t glob_says_pass, const filter_info_t &info) override {
+    const auto dir = info.get_basepath().lexically_normal();
+    if (directories.empty() || directories.back() != dir) {
+      directories.push_back(dir);
+    }
+    orders.insert(info.traversal);
+    return glob_says_pass;
+  }
+
+  // every directory is a subdirectory of one scanned before, or of one of their parents: a pre-order walk
+  bool is_depth_first() const {
+    for (size_t index = 1; index < directories.size(); index++) {
+      const auto parent = directories[index].parent_path();
+      auto rel = directories[index - 1].lexically_relative(parent);
+      if (rel.empty() || *rel.begin() == "..") {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+TEST(globOptionsTest, TraversalOrder) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  traversal_options bfs(temp_dir, "**/*");
+  const auto expected = sorted_strings(glob::glob(bfs));
+  EXPECT_EQ(expected.size(), 9);
+  EXPECT_FALSE(bfs.is_depth_first());
+  EXPECT_EQ(bfs.orders, std::set<glob::traversal_order>{glob::traversal_order::breadth_first});
+
+  traversal_options dfs(temp_dir, "**/*");
+  dfs.traversal = glob::traversal_order::depth_first;
+  EXPECT_EQ(sorted_strings(glob::glob(dfs)), expected);
+  EXPECT_EQ(dfs.directories.size(), 6);
+  EXPECT_TRUE(dfs.is_depth_first());
+  EXPECT_EQ(dfs.orders, std::set<glob::traversal_order>{glob::traversal_order::depth_first});
+
+  dfs.directories.clear();
+  dfs.merge_overlapping_specs = true;
+  dfs.pathnames = {"**/*.cpp", "src/**/*", "docs/*"};
+  dfs.init_max_recursion_depth_set();
+  EXPECT_EQ(glob::glob(dfs).size(), 13);
+  EXPECT_TRUE(dfs.is_depth_first());
+
+  traversal_options hybrid(temp_dir, "**/*");
+  hybrid.traversal = glob::traversal_order::hybrid;
+  EXPECT_EQ(sorted_strings(glob::glob(hybrid)), expected);
+  EXPECT_EQ(hybrid.orders, std::set<glob::traversal_order>{glob::traversal_order::breadth_first});
+
+  hybrid.hybrid_queue_limit = 1;
+  hybrid.orders.clear();
+  EXPECT_EQ(sorted_strings(glob::glob(hybrid)), expected);
+  EXPECT_TRUE(hybrid.orders.count(glob::traversal_order::depth_first));
+}
+
+TEST(pathArenaTest, CollectsResults) {
+  glob::path_arena arena;
+  EXPECT_TRUE(arena.empty());
+  arena.push_back(fs::path("src/a.cpp").native());
+  arena.push_back(fs::path("").native());
+  arena.push_back(fs::path("docs/readme.pdf").native());
+  EXPECT_EQ(arena.size(), 3);
+  EXPECT_EQ(arena.path(0), fs::path("src/a.cpp"));
+  EXPECT_TRUE(arena[1].empty());
+  EXPECT_EQ(arena.path(2), fs::path("docs/readme.pdf"));
+  EXPECT_EQ(arena.characters(), 24);
+  EXPECT_EQ(std::distance(arena.begin(), arena.end()), 3);
+
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+  glob::options spec(temp_dir, std::vector<std::string>{"**/*.cpp", "src/*/CMakeLists.txt"});
+  const auto expected = sorted_strings(glob::glob(spec));
+
+  arena.clear();
+  glob::glob(spec, arena);
+  EXPECT_EQ(sorted_strings(arena.to_paths()), expected);
+
+  std::vector<fs::path> paths;
+  spec.thread_count = 4;
+  glob::glob(spec, arena);
+  for (auto path : arena) {
+    paths.emplace_back(path);
+  }
+  EXPECT_EQ(paths.size(), 2 * expected.size());
+  paths.erase(paths.begin(), paths.begin() + expected.size());
+  EXPECT_EQ(sorted_strings(paths), expected);
+}
+
+TEST(pathTreeTest, SharesDirectories) {
+  glob::path_tree tree;
+  for (auto path : {"/srv/data/2026/10/a.log", "/srv/data/2026/10/b.log", "/srv/data/2026/11/a.log", "x.txt", "/srv/data", "rel/dir//y"}) {
+    tree.push_back(path);
+  }
+  EXPECT_EQ(tree.size(), 6);
+  EXPECT_EQ(tree.to_paths(), (std::vector<fs::path>{"/srv/data/2026/10/a.log", "/srv/data/2026/10/b.log", "/srv/data/2026/11/a.log",
+                                                    "x.txt", "/srv/data", "rel/dir//y"}));
+  // "/", "srv/", "data/", "2026/", "10/", "11/" and "rel/", "dir/", "/"
+  EXPECT_EQ(tree.directory_count(), 9);
+
+  const auto dir = tree.directory(0);
+  EXPECT_EQ(tree.directory(1), dir);
+  EXPECT_EQ(tree.directory_path(dir), fs::path("/srv/data/2026/10"));
+  EXPECT_EQ(tree.entries(dir), (std::vector<std::size_t>{0, 1}));
+  EXPECT_EQ(tree.parent(tree.directory(2)), tree.parent(dir));
+  EXPECT_EQ(fs::path(tree.name(2)), fs::path("a.log"));
+  EXPECT_EQ(tree.directory(3), glob::path_tree::no_directory);
+  EXPECT_EQ(tree.directory_path(tree.directory(4)), fs::path("/srv"));
+
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+  glob::options spec(temp_dir, "**/*.cpp");
+  const auto expected = sorted_strings(glob::glob(spec));
+
+  tree.clear();
+  glob::glob(spec, tree);
+  EXPECT_EQ(sorted_strings(tree.to_paths()), expected);
+  std::size_t in_src = 0;
+  for (std::size_t dir = 0; dir < tree.directory_count(); dir++) {
+    if (tree.directory_path(dir).lexically_normal() == (temp_dir / "src").lexically_normal())
+      in_src = tree.entries(dir).size();
+  }
+  EXPECT_EQ(in_src, 1);
+
+  tree.clear();
+  spec.thread_count = 3;
+  glob::glob(spec, tree);
+  EXPECT_EQ(sorted_strings(tree.to_paths()), expected);
+}
+
+// checks the paths reported by filter_info_t, both its fields and its accessors, against the path passed to filter()
+struct info_checking_options : glob::options {
+  using glob::options::options;
+
+  int checked = 0;
+  int mismatches = 0;
+
+  filter_state_t filter(fs::path path, filter_state_t glob_says_pass, const filter_info_t &info) override {
+    if (!info.get_item_relpath().empty()) {
+      checked++;
+      if (path != info.get_basepath() / info.get_item_relpath() || info.get_matching_wildcarded_fragment() != "*.cpp" ||
+          !info.get_subsearch_spec().empty()) {
+        mismatches++;
+      }
+      if (copy_filter_info_paths ? path != info.basepath / info.item_relpath || info.matching_wildcarded_fragment != "*.cpp"
+                                 : !info.basepath.empty() || !info.item_relpath.empty()) {
+        mismatches++;
+      }
+    }
+    return glob_says_pass;
+  }
+};
+
+TEST(globOptionsTest, FilterInfoView) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  for (bool copy : {false, true}) {
+    for (bool native : {false, true}) {
+      info_checking_options spec(temp_dir / "src", "*.cpp");
+      spec.copy_filter_info_paths = copy;
+      spec.use_native_directory_reader = native;
+      EXPECT_EQ(glob::glob(spec).size(), 1);
+      EXPECT_EQ(spec.checked, 5);   // a.cpp, a.h, CMakeLists.txt, core/, net/
+      EXPECT_EQ(spec.mismatches, 0);
+    }
+  }
+
+  // the same result from a plain glob::options, which skips the callbacks altogether
+  glob::options plain(temp_dir / "src", "*.cpp");
+  EXPECT_EQ(glob::glob(plain).size(), 1);
+}
+
+struct sources_only {
+  static constexpr bool include_matching_directories = true;
+
+  int filtered = 0;
+
+  glob::options::filter_state_t filter(glob::options::filter_state_t state, const glob::options::filter_info_t &info) {
+    filtered++;
+    state.accept &= info.is_directory || info.get_item_relpath().extension() == ".cpp";
+    return state;
+  }
+};
+
+struct virtual_sources_only : glob::options {
+  using glob::options::options;
+
+  filter_state_t filter(fs::path path, filter_state_t state, const filter_info_t &info) override {
+    state.accept &= info.is_directory || path.extension() == ".cpp";
+    return state;
+  }
+};
+
+struct no_callbacks {
+  static constexpr bool include_matching_files = false;
+  static constexpr bool include_matching_directories = true;
+};
+
+TEST(basicGlobTest, ResolvesPolicyAtCompileTime) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  glob::basic_glob<sources_only> sources(glob::options(temp_dir, "src/*"));
+  EXPECT_EQ(sorted_strings(sources.run()),
+            sorted_strings({temp_dir / "src/a.cpp", temp_dir / "src/core", temp_dir / "src/net"}));
+  EXPECT_EQ(sources.callbacks().filtered, 5);   // a.cpp, a.h, CMakeLists.txt, core/, net/
+
+  // through '**', which hands the directory itself to filter() and its entries to the batched loop: the same results as
+  // the virtual filter() of an options subclass
+  glob::basic_glob<sources_only> recursive(glob::options(temp_dir, "src/**"));
+  virtual_sources_only virtual_filter(temp_dir, "src/**");
+  virtual_filter.include_matching_directories = true;
+  EXPECT_EQ(sorted_strings(recursive.run()), sorted_strings(glob::glob(virtual_filter)));
+
+  glob::basic_glob<no_callbacks> directories(glob::options(temp_dir, "src/*"));
+  glob::path_arena arena;
+  directories.run(arena);
+  EXPECT_EQ(sorted_strings(arena.to_paths()), sorted_strings({temp_dir / "src/core", temp_dir / "src/net"}));
+}
+
+std::vector<std::string> generic_strings(const std::vector<fs::path> &paths) {
+  std::vector<std::string> result;
+  for (auto &p : paths) {
+    result.push_back(p.generic_string());
+  }
+  return result;
+}
+
+TEST(globOptionsTest, ResultOrder) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+  for (auto f : {"docs/page10.txt", "docs/page2.txt", "docs/page1.txt"}) {
+    std::ofstream(temp_dir / f).close();
+  }
+  const std::string base = temp_dir.generic_string() + "/";
+
+  glob::options spec(temp_dir, "docs/*.txt");
+  spec.ordering = glob::result_order::bytes;
+  EXPECT_EQ(generic_strings(glob::glob(spec)), (std::vector<std::string>{base + "docs/page1.txt", base + "docs/page10.txt", base + "docs/page2.txt"}));
+  spec.ordering = glob::result_order::natural;
+  EXPECT_EQ(generic_strings(glob::glob(spec)), (std::vector<std::string>{base + "docs/page1.txt", base + "docs/page2.txt", base + "docs/page10.txt"}));
+
+  glob::options tree(temp_dir, "src/**/*.cpp");
+  tree.ordering = glob::result_order::bytes;
+  const std::vector<std::string> by_pathname{base + "src/a.cpp", base + "src/core/sub/z.cpp", base + "src/core/x.cpp", base + "src/net/n.cpp"};
+  EXPECT_EQ(generic_strings(glob::glob(tree)), by_pathname);
+  tree.thread_count = 4;
+  EXPECT_EQ(generic_strings(glob::glob(tree)), by_pathname);
+
+  glob::path_arena arena;
+  glob::glob(tree, arena);
+  EXPECT_EQ(generic_strings(arena.to_paths()), by_pathname);
+
+  // each directory's own matches come before those of its subdirectories
+  tree.ordering = glob::result_order::directory;
+  EXPECT_EQ(generic_strings(glob::glob(tree)),
+            (std::vector<std::string>{base + "src/a.cpp", base + "src/core/x.cpp", base + "src/core/sub/z.cpp", base + "src/net/n.cpp"}));
+}
+
+TEST(globOptionsTest, Deduplicate) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  glob::options spec(temp_dir, std::vector<std::string>{"**/*.cpp", "src/*.cpp", "./src/a.*"});
+  EXPECT_EQ(glob::glob(spec).size(), 4 + 1 + 2);
+  spec.deduplicate = glob::dedup_mode::path;
+  EXPECT_EQ(sorted_strings(glob::glob(spec)),
+            sorted_strings({temp_dir / "src/a.cpp", temp_dir / "src/a.h", temp_dir / "src/core/x.cpp", temp_dir / "src/core/sub/z.cpp",
+                            temp_dir / "src/net/n.cpp"}));
+
+  // a hardlink is another path to the same file
+  fs::create_hard_link(temp_dir / "src/a.cpp", temp_dir / "docs/a.cpp");
+  glob::options links(temp_dir, "**/*.cpp");
+  links.deduplicate = glob::dedup_mode::path;
+  EXPECT_EQ(glob::glob(links).size(), 5);
+#if !defined(_WIN32)
+  links.deduplicate = glob::dedup_mode::file;
+  EXPECT_EQ(glob::glob(links).size(), 4);
+  links.thread_count = 4;
+  EXPECT_EQ(glob::glob(links).size(), 4);
+
+  // the native reader identifies the files from its listing, a symlink by the file it refers to
+  fs::create_symlink(temp_dir / "src/core/x.cpp", temp_dir / "docs/x.cpp");
+  links.thread_count = 1;
+  for (bool native : {false, true}) {
+    links.use_native_directory_reader = native;
+    EXPECT_EQ(glob::glob(links).size(), 4);
+  }
+#endif
+
+  const std::string base = temp_dir.string();
+  EXPECT_EQ(glob::glob_path(base, {"src/*.cpp", "src/a.*"}).size(), 3);
+  EXPECT_EQ(glob::glob_path(base, {"src/*.cpp", "src/a.*"}, glob::match_flags::deduplicate).size(), 2);
+}
+
+// rejects the ".h" files of every directory in a single filter_batch() call
+struct batch_options : glob::options {
+  using glob::options::options;
+
+  int batches = 0;
+  int batched_entries = 0;
+  int filtered = 0;
+
+  void filter_batch(const fs::path &basepath, batch_entries_t entries, const filter_info_t &info) override {
+    batches++;
+    batched_entries += (int)entries.size();
+    for (auto &entry : entries) {
+      if (entry.name.ends_with(".h")) {
+        entry.verdict.accept = false;
+      }
+    }
+  }
+
+  filter_state_t filter(fs::path path, filter_state_t glob_says_pass, const filter_info_t &info) override {
+    filtered++;
+    return glob_says_pass;
+  }
+};
+
+TEST(globOptionsTest, BatchFilter) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+
+  batch_options spec(temp_dir, "src/**/*");
+  const auto all = glob::glob(spec);
+  EXPECT_EQ(all.size(), 8);
+  EXPECT_EQ(spec.batches, 0);
+
+  spec.use_batch_filter = true;
+  spec.filtered = 0;
+  EXPECT_EQ(sorted_strings(glob::glob(spec)),
+            sorted_strings({temp_dir / "src/a.cpp", temp_dir / "src/CMakeLists.txt", temp_dir / "src/core/x.cpp",
+                            temp_dir / "src/core/sub/z.cpp", temp_dir / "src/net/n.cpp", temp_dir / "src/net/CMakeLists.txt"}));
+  // every entry of src, src/core, src/core/sub and src/net went through a batch at least once
+  EXPECT_GE(spec.batches, 4);
+  EXPECT_GE(spec.batched_entries, 5 + 3 + 1 + 2);
+  // only the directories matched by "**" themselves are passed to filter()
+  EXPECT_EQ(spec.filtered, 4);
+}
+
+TEST(preparedQueryTest, RunsRepeatedlyAndConcurrently) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+  glob::options spec(temp_dir, std::vector<std::string>{"**/*.cpp", "src/*/CMakeLists.txt", "~/does/not/exist/*"});
+
+  const auto expected = sorted_strings(glob::glob(spec));
+  const glob::prepared_query query(spec);
+  EXPECT_EQ(sorted_strings(query.run()), expected);
+  EXPECT_EQ(sorted_strings(query.run()), expected);
+
+  std::vector<std::vector<std::string>> results(4);
+  std::vector<std::thread> threads;
+  for (auto &result : results) {
+    threads.emplace_back([&query, &result]() {
+      counting_options callbacks(fs::path(), "");
+      result = sorted_strings(query.run(callbacks));
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto &result : results) {
+    EXPECT_EQ(result, expected);
+  }
+}
+
+// rejects everything
+struct rejecting_options : glob::options {
+  using glob::options::options;
+
+  filter_state_t filter(fs::path path, filter_state_t glob_says_pass, const filter_info_t &info) override {
+    glob_says_pass.accept = false;
+    return glob_says_pass;
+  }
+};
+
+TEST(preparedQueryTest, KeepsTheCallbacksOfItsOptions) {
+  const temp_tree scratch;
+  const fs::path &temp_dir = scratch.path;
+  rejecting_options spec(temp_dir, "**/*.cpp");
+  EXPECT_TRUE(glob::glob(spec).empty());
+
+  const glob::prepared_query query(spec);
+  EXPECT_TRUE(query.run().empty());
+  EXPECT_TRUE(query.run().empty());
+
+  // a const options is copied, like `glob(const options&)` does
+  const glob::prepared_query copied(static_cast<const glob::options &>(spec));
+  EXPECT_EQ(copied.run().size(), 4);
+}
@@ -1,6 +1,7 @@
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
+#include <random>
 #include <stdlib.h>
 
 #ifdef USE_SINGLE_HEADER
@@ -11,13 +12,26 @@
 
 namespace fs = std::filesystem;
 
-fs::path mkdir_temp() {
-  std::srand(std::time(nullptr));
-  fs::path temp_dir = fs::temp_directory_path() / ("rglob_test_" + std::to_string(std::rand()));
+// A scratch directory, removed again when the test is done.
+struct temp_dir_guard {
+  temp_dir_guard() {
+    // create_directory() fails for a name which is already taken, e.g. by a concurrently running test binary.
+    static std::random_device entropy;
+    do {
+      path = fs::temp_directory_path() / ("rglob_test_" + std::to_string(entropy()));
+    } while (!fs::create_directory(path));
+  }
 
-  fs::create_directories(temp_dir);
-  return temp_dir;
-}
+  ~temp_dir_guard() {
+    std::error_code ec;
+    fs::remove_all(path, ec);
+  }
+
+  temp_dir_guard(const temp_dir_guard &) = delete;
+  temp_dir_guard &operator=(const temp_dir_guard &) = delete;
+
+  fs::path path;
+};
 
 // regression test to avoid matching an non existing file
 TEST(rglobTest, MatchNonExistent) {
@@ -27,7 +41,8 @@ TEST(rglobTest, MatchNonExistent) {
 
 // see https://github.com/p-ranav/glob/issues/3
 TEST(rglobTest, Issue3) {
-  auto temp_dir = mkdir_temp();
+  const temp_dir_guard scratch;
+  const fs::path &temp_dir = scratch.path;
   std::cout << "Temporary directory: " << temp_dir << std::endl;
 
   fs::path sub1 = temp_dir / "sub";